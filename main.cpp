@@ -1,8 +1,26 @@
 #include <iostream>
 #include <vector>
 #include <array>
+#include <bitset>
+#include <memory>
+#include <algorithm>
+#include <chrono>
 #include <cassert>
 #include <cmath>
+#include <cstdint>
+#include <deque>
+#include <tuple>
+#include <utility>
+#include <atomic>
+#include <mutex>
+#include <condition_variable>
+#include <thread>
+#include <limits>
+#include <string>
+#include <stdexcept>
+#if defined(__AVX__) || defined(__SSE2__) || defined(_M_X64)
+#include <immintrin.h>
+#endif
 #include <SFML/Graphics.hpp>
 
 namespace Arkanoid
@@ -10,539 +28,3697 @@ namespace Arkanoid
     struct Component;
     class Entity;
     class EntityContainer;
+    class Prefab;
 
     using ComponentID = std::size_t;
     using Group = std::size_t;
+    using EntityIndex = std::uint32_t;
+    using EntityGeneration = std::uint32_t;
+
+    template <typename... Ts>
+    struct TypeList
+    {
+    };
+
+    struct CPosition;
+    struct CPhysics;
+    struct CStaticBody;
+    struct CCircle;
+    struct CRectangle;
+    struct CPaddleControl;
+
+    // Every component type must be registered here. A component's ID is its
+    // position in this list, so IDs are compile-time constants that do not
+    // depend on first-use order.
+    using ComponentList = TypeList<CPosition, CPhysics, CStaticBody, CCircle,
+                                   CRectangle, CPaddleControl>;
 
     namespace Internal
     {
-        inline ComponentID getUniqueComponentID() noexcept
+        template <typename T>
+        struct AlwaysFalse : std::false_type
         {
-            static ComponentID lastID{0u};
-            return lastID++;
-        }
+        };
+
+        template <typename T, typename TList>
+        struct IndexOf;
+
+        template <typename T>
+        struct IndexOf<T, TypeList<>>
+        {
+            static_assert(AlwaysFalse<T>::value,
+                          "T is not registered in ComponentList");
+        };
+
+        template <typename T, typename... Ts>
+        struct IndexOf<T, TypeList<T, Ts...>>
+                : std::integral_constant<std::size_t, 0>
+        {
+        };
+
+        template <typename T, typename TFirst, typename... Ts>
+        struct IndexOf<T, TypeList<TFirst, Ts...>>
+                : std::integral_constant<std::size_t,
+                                         1 + IndexOf<T, TypeList<Ts...>>::value>
+        {
+        };
+
+        template <typename TList>
+        struct Size;
+
+        template <typename... Ts>
+        struct Size<TypeList<Ts...>>
+                : std::integral_constant<std::size_t, sizeof...(Ts)>
+        {
+        };
     }
 
     template <typename T>
-    inline ComponentID getComponentTypeID() noexcept
+    constexpr ComponentID getComponentTypeID() noexcept
     {
         static_assert(std::is_base_of<Component, T>::value,
                       "T must inherit from Component");
 
-        static ComponentID typeID{Internal::getUniqueComponentID()};
-        return typeID;
+        return Internal::IndexOf<T, ComponentList>::value;
     }
 
     constexpr std::size_t maxComponents{32};
     using ComponentBitset = std::bitset<maxComponents>;
-    using ComponentArray = std::array<Component*, maxComponents>;
 
-    constexpr std::size_t maxGroups{32};
-    using GroupBitset = std::bitset<maxGroups>;
+    static_assert(Internal::Size<ComponentList>::value <= maxComponents,
+                  "Too many registered components");
 
-    struct Component
+    namespace Internal
+    {
+        template <typename... Ts>
+        struct SignatureMask : std::integral_constant<unsigned long long, 0>
+        {
+        };
+
+        template <typename T, typename... Ts>
+        struct SignatureMask<T, Ts...>
+                : std::integral_constant<unsigned long long,
+                                         (1ull << getComponentTypeID<T>()) |
+                                                 SignatureMask<Ts...>::value>
+        {
+        };
+    }
+
+    // Component bitset of `Ts...`, folded at compile time.
+    template <typename... Ts>
+    constexpr ComponentBitset getSignature() noexcept
     {
-        Entity* entity;
+        return ComponentBitset{Internal::SignatureMask<Ts...>::value};
+    }
+    using ComponentIndexArray = std::array<std::size_t, maxComponents>;
+
+    constexpr std::size_t maxGroups{32};
+    using GroupBitset = std::bitset<maxGroups>;
 
-        virtual void init() {};
-        virtual void update(float mFT) {}
-        virtual void draw(sf::RenderWindow& renderWindow) {}
+    constexpr EntityIndex invalidEntityIndex{
+            std::numeric_limits<EntityIndex>::max()};
 
-        virtual ~Component() {}
+    // Handle to an entity slot. The generation is bumped every time the slot
+    // is recycled, so a handle outliving its entity is detected as stale
+    // instead of silently aliasing whatever reuses the slot.
+    struct EntityID
+    {
+        EntityIndex index{invalidEntityIndex};
+        EntityGeneration generation{0};
     };
 
+    // Lightweight, copyable view of an entity owned by an EntityContainer.
     class Entity
     {
     private:
-        EntityContainer& container;
-        bool alive{true};
-        std::vector<std::unique_ptr<Component>> components;
-        ComponentArray componentArray;
-        ComponentBitset componentBitset;
-        GroupBitset groupBitset;
+        EntityContainer* container{nullptr};
+        EntityID id;
 
     public:
-        Entity(EntityContainer& container) : container(container) {}
-
-        void update(float mFT)
+        Entity() = default;
+        Entity(EntityContainer& container, EntityID id)
+                : container(&container), id(id)
         {
-            for(auto& c : components) c->update(mFT);
         }
 
-        void draw(sf::RenderWindow& renderWindow)
-        {
-            for(auto& c : components) c->draw(renderWindow);
-        }
+        EntityID getID() const noexcept { return id; }
+        EntityIndex getIndex() const noexcept { return id.index; }
 
-        bool isAlive() const { return alive; }
-        void destroy() { alive = false; }
+        bool isAlive() const;
+        void destroy();
 
         template <typename T>
-        bool hasComponent() const
-        {
-            return componentBitset[getComponentTypeID<T>()];
-        }
-
-        bool hasGroup(Group mGroup) const noexcept
-        {
-            return groupBitset[mGroup];
-        }
+        bool hasComponent() const;
 
+        bool hasGroup(Group mGroup) const noexcept;
         void addGroup(Group mGroup) noexcept;
-        void delGroup(Group mGroup) noexcept { groupBitset[mGroup] = false; }
+        void delGroup(Group mGroup) noexcept;
 
         template <typename T, typename... TArgs>
-        void addComponent(TArgs&&... mArgs)
-        {
-            assert(!hasComponent<T>());
+        void addComponent(TArgs&&... mArgs);
 
-            T* component(new T(std::forward<TArgs>(mArgs)...));
-            component->entity = this;
-            std::unique_ptr<Component> uPtr{component};
-            components.emplace_back(std::move(uPtr));
+        template <typename T>
+        T& getComponent() const;
 
-            //auto component = std::make_unique<T>(mArgs...);
-            //components.emplace_back(std::move(component));
+        template <typename T>
+        void removeComponent();
+    };
 
-            componentArray[getComponentTypeID<T>()] = component;
-            componentBitset[getComponentTypeID<T>()] = true;
+    struct Component
+    {
+        Entity entity;
+    };
 
-            component->init();
-        }
+    // Base for systems: `TComponents` is the signature an entity must match
+    // for the system to visit it. `Reads` and `Writes` declare the
+    // component access the SystemSchedule orders systems by; derived
+    // systems narrow them when they only read part of their signature.
+    template <typename... TComponents>
+    struct System
+    {
+        using Signature = TypeList<TComponents...>;
+        using Reads = TypeList<>;
+        using Writes = TypeList<TComponents...>;
+    };
 
+    namespace Internal
+    {
+        // Makes room for `mCount` elements in total. Growing at least
+        // doubles the capacity, so repeated bulk reserves stay amortized
+        // instead of reallocating on every call.
         template <typename T>
-        T& getComponent() const
+        void reserveAmortized(std::vector<T>& mVector, std::size_t mCount)
         {
-            assert(hasComponent<T>());
-            auto ptr(componentArray[getComponentTypeID<T>()]);
-            return *reinterpret_cast<T*>(ptr);
+            if(mCount > mVector.capacity())
+                mVector.reserve(std::max(mCount, mVector.capacity() * 2));
         }
-    };
-
-    struct EntityContainer
-    {
-    private:
-        std::vector<std::unique_ptr<Entity>> entities;
-        std::array<std::vector<Entity*>, maxGroups> groupedEntities;
 
-    public:
-        void update(float mFT)
+        struct EntityRecord
         {
-            for(auto& e : entities) e->update(mFT);
-        }
-        void draw(sf::RenderWindow& renderWindow)
+            EntityGeneration generation{0};
+            bool alive{false};
+            std::size_t denseIndex;
+            ComponentIndexArray componentIndices;
+            ComponentBitset componentBitset;
+
+            // `groupBitset` is what the entity asked for; `groupMembership`
+            // is what the group sets currently hold. They only differ
+            // between a delGroup() and the next refresh().
+            GroupBitset groupBitset;
+            GroupBitset groupMembership;
+        };
+
+        // Sparse set of entities: dense storage for linear iteration plus a
+        // sparse index-to-position map for O(1) membership and removal.
+        class EntitySet
         {
-            for(auto& e : entities) e->draw(renderWindow);
-        }
+        private:
+            std::vector<Entity> dense;
+            std::vector<std::size_t> sparse;
+
+        public:
+            void insert(const Entity& mEntity)
+            {
+                auto index(mEntity.getIndex());
+                if(index >= sparse.size()) sparse.resize(index + 1);
+
+                sparse[index] = dense.size();
+                dense.emplace_back(mEntity);
+            }
 
-        void addToGroup(Entity* mEntity, Group mGroup)
+            void erase(EntityIndex mIndex)
+            {
+                auto position(sparse[mIndex]);
+                dense[position] = dense.back();
+                sparse[dense[position].getIndex()] = position;
+                dense.pop_back();
+            }
+
+            std::vector<Entity>& getEntities() noexcept { return dense; }
+
+            void clear() noexcept { dense.clear(); }
+        };
+
+        // Entities matching a component signature, kept up to date as
+        // components are added and removed and as entities are released.
+        struct ViewCache
         {
-            groupedEntities[mGroup].emplace_back(mEntity);
-        }
+            ComponentBitset signature;
+            EntitySet entities;
+
+            bool matches(const ComponentBitset& mBitset) const noexcept
+            {
+                return (mBitset & signature) == signature;
+            }
+        };
 
-        std::vector<Entity*>& getEntitiesByGroup(Group mGroup)
+        struct ComponentPoolBase
         {
-            return groupedEntities[mGroup];
-        }
+            // Swap-and-pops the component at `mIndex` and returns the owner
+            // of the component moved into its slot, if any.
+            virtual EntityIndex remove(std::size_t mIndex) = 0;
 
-        void refresh()
+            // Destroys every component but keeps the slabs for reuse.
+            virtual void clear() = 0;
+
+            virtual ~ComponentPoolBase() {}
+        };
+
+        // Dense storage for every component of type T. Components are kept
+        // packed in fixed-size slabs so systems walk memory linearly and
+        // growth never relocates existing components; removal swaps the
+        // last element into the hole. Slabs are only released with the
+        // pool, so steady-state spawning and destruction reuse them.
+        template <typename T>
+        class ComponentPool : public ComponentPoolBase
         {
-            for(auto i(0u); i < maxGroups; ++i)
+        private:
+            static constexpr std::size_t slabSize{256};
+            using Slot =
+                    typename std::aligned_storage<sizeof(T), alignof(T)>::type;
+            using Slab = std::array<Slot, slabSize>;
+
+            std::vector<std::unique_ptr<Slab>> slabs;
+            std::vector<EntityIndex> owners;
+
+            T* slot(std::size_t mIndex) noexcept
             {
-                auto& v(groupedEntities[i]);
+                auto& slab(*slabs[mIndex / slabSize]);
+                return reinterpret_cast<T*>(&slab[mIndex % slabSize]);
+            }
 
-                v.erase(std::remove_if(std::begin(v), std::end(v),
-                                       [i](Entity* mEntity)
-                                       {
-                                           return !mEntity->isAlive() ||
-                                                  !mEntity->hasGroup(i);
-                                       }),
-                        std::end(v));
+            void addSlabs(std::size_t mCount)
+            {
+                while(slabs.size() * slabSize < mCount)
+                    slabs.emplace_back(new Slab);
             }
 
-            entities.erase(
-                    std::remove_if(std::begin(entities), std::end(entities),
-                                   [](const std::unique_ptr<Entity>& mEntity)
-                                   {
-                                       return !mEntity->isAlive();
-                                   }),
-                    std::end(entities));
-        }
+        public:
+            ComponentPool() = default;
+            ComponentPool(const ComponentPool&) = delete;
+            ComponentPool& operator=(const ComponentPool&) = delete;
 
-        void addEntity(std::unique_ptr<Entity>&& entity)
-        {
-            entities.emplace_back(std::move(entity));
-        }
-    };
+            ~ComponentPool() { clear(); }
 
-    void Entity::addGroup(Group mGroup) noexcept
-    {
-        groupBitset[mGroup] = true;
-        container.addToGroup(this, mGroup);
-    }
+            void reserve(std::size_t mCount)
+            {
+                addSlabs(mCount);
+                reserveAmortized(owners, mCount);
+            }
 
-    using namespace std;
-    using namespace sf;
-    using FrameTime = float;
+            template <typename... TArgs>
+            std::size_t add(EntityIndex mOwner, TArgs&&... mArgs)
+            {
+                // `owners` grows geometrically on its own; an exact
+                // reserve here would reallocate it on every add.
+                auto index(owners.size());
+                if(index == slabs.size() * slabSize)
+                    slabs.emplace_back(new Slab);
+
+                new(slot(index)) T(std::forward<TArgs>(mArgs)...);
+                owners.emplace_back(mOwner);
+                return index;
+            }
 
-    constexpr int windowWidth{800}, windowHeight{600};
-    constexpr float ballRadius{10.f}, ballVelocity{0.6f};
-    constexpr float paddleWidth{60.f}, paddleHeight{20.f}, paddleVelocity{0.6f};
-    constexpr float blockWidth{60.f}, blockHeight{20.f};
-    constexpr int countBlocksX{11}, countBlocksY{4};
-    constexpr float ftStep{1.f}, ftSlice{1.f};
+            T& get(std::size_t mIndex) noexcept { return *slot(mIndex); }
+            EntityIndex getOwner(std::size_t mIndex) const noexcept
+            {
+                return owners[mIndex];
+            }
+            std::size_t size() const noexcept { return owners.size(); }
 
-    struct Game;
+            EntityIndex remove(std::size_t mIndex) override
+            {
+                auto last(owners.size() - 1);
+                auto moved(invalidEntityIndex);
+                if(mIndex != last)
+                {
+                    *slot(mIndex) = std::move(*slot(last));
+                    owners[mIndex] = owners[last];
+                    moved = owners[mIndex];
+                }
 
-    struct CPosition : Component
-    {
-        Vector2f position;
+                slot(last)->~T();
+                owners.pop_back();
+                return moved;
+            }
 
-        CPosition() = default;
-        CPosition(const Vector2f& mPosition) : position{mPosition} {}
+            // Copy-constructs `mCount` components from `mPrototype` at the
+            // end of the pool, one slab span at a time; `mOwner(i)` gives
+            // the owner of the i-th copy. Returns the index of the first.
+            template <typename TF>
+            std::size_t append(const T& mPrototype, std::size_t mCount,
+                               TF&& mOwner)
+            {
+                auto first(owners.size());
+                reserve(first + mCount);
 
-        float x() const noexcept { return position.x; }
-        float y() const noexcept { return position.y; }
-    };
+                for(auto i(first); i < first + mCount;)
+                {
+                    auto span(std::min(slabSize - i % slabSize,
+                                       first + mCount - i));
+                    std::uninitialized_fill_n(slot(i), span, mPrototype);
+                    i += span;
+                }
 
-    struct CPhysics : Component
-    {
-        Vector2f velocity, halfSize;
+                for(std::size_t i{0}; i < mCount; ++i)
+                    owners.emplace_back(mOwner(i));
+
+                return first;
+            }
 
-        std::function<void(const Vector2f&)> onOutOfBounds;
+            void clear() override
+            {
+                for(std::size_t i{0}; i < owners.size(); ++i) slot(i)->~T();
+                owners.clear();
+            }
+        };
 
-        CPhysics(const Vector2f& mHalfSize) : halfSize{mHalfSize} {}
+        template <typename TSystem, typename TSignature>
+        struct SystemRunner;
 
-        CPosition* Position() const
+        template <typename TSystem, typename... TComponents>
+        struct SystemRunner<TSystem, TypeList<TComponents...>>
         {
-            return &entity->getComponent<CPosition>();
-        }
+            template <typename... TArgs>
+            static void run(EntityContainer& mContainer, TSystem& mSystem,
+                            TArgs&&... mArgs);
+        };
 
-        void update(float mFT) override
+        template <typename... TSystems>
+        struct SystemListRunner
         {
-            Position()->position += velocity * mFT;
+            template <typename... TArgs>
+            static void run(EntityContainer& mContainer, TArgs&&... mArgs)
+            {
+                using Expander = int[];
+                (void)Expander{0, (runSystem<TSystems>(mContainer, mArgs...),
+                                   0)...};
+            }
 
-            if(onOutOfBounds == nullptr) return;
+        private:
+            template <typename TSystem, typename... TArgs>
+            static void runSystem(EntityContainer& mContainer,
+                                  TArgs&&... mArgs)
+            {
+                TSystem system;
+                SystemRunner<TSystem, typename TSystem::Signature>::run(
+                        mContainer, system, mArgs...);
+            }
+        };
+    }
 
-            if(left() < 0)
-                onOutOfBounds(Vector2f{1.f, 0.f});
-            else if(right() > windowWidth)
-                onOutOfBounds(Vector2f{-1.f, 0.f});
+    // Compile-time list of systems, run in declaration order.
+    template <typename... TSystems>
+    using SystemList = Internal::SystemListRunner<TSystems...>;
 
-            if(top() < 0)
-                onOutOfBounds(Vector2f{0.f, 1.f});
-            else if(bottom() > windowHeight)
-                onOutOfBounds(Vector2f{0.f, -1.f});
-        }
+    // Result of EntityContainer::view<Ts...>(). Iterating it yields the
+    // matching entities; each() hands the callback direct references to
+    // their components. Structural changes are not allowed meanwhile.
+    // The pools are looked up once, when the view is made.
+    template <typename... Ts>
+    class View
+    {
+    private:
+        EntityContainer* container;
+        Internal::ViewCache* cache;
+        std::tuple<Internal::ComponentPool<Ts>*...> pools;
 
-        float x() const noexcept { return Position()->x(); }
-        float y() const noexcept { return Position()->y(); }
-        float left() const noexcept { return x() - halfSize.x; }
-        float right() const noexcept { return x() + halfSize.x; }
-        float top() const noexcept { return y() - halfSize.y; }
-        float bottom() const noexcept { return y() + halfSize.y; }
-    };
+        // Every component of a single-type view's pool matches it, so
+        // the pool is walked directly.
+        template <typename TF, typename T>
+        void eachIn(std::size_t mBegin, std::size_t mEnd, TF& mFn,
+                    Internal::ComponentPool<T>& mPool);
 
-    struct CCircle : Component
-    {
-        CircleShape shape;
-        float radius;
+        template <typename TF, typename... TPools>
+        void eachIn(std::size_t mBegin, std::size_t mEnd, TF& mFn,
+                    TPools&... mPools);
 
-        CCircle(float mRadius) : radius{mRadius} {}
+    public:
+        View(EntityContainer& mContainer, Internal::ViewCache& mCache);
 
-        CPosition* Position() const
+        std::size_t size() const noexcept
         {
-            return &entity->getComponent<CPosition>();
+            return cache->entities.getEntities().size();
         }
 
-        void init() override
+        std::vector<Entity>::iterator begin() noexcept
         {
-            shape.setRadius(radius);
-            shape.setFillColor(Color::Red);
-            shape.setOrigin(radius, radius);
+            return cache->entities.getEntities().begin();
         }
 
-        void update(float mFT) override
+        std::vector<Entity>::iterator end() noexcept
         {
-            shape.setPosition(Position()->position);
+            return cache->entities.getEntities().end();
         }
 
-        void draw(sf::RenderWindow& renderWindow) override
+        template <typename TF>
+        void each(TF&& mFn)
         {
-            renderWindow.draw(shape);
+            each(0, size(), mFn);
         }
+
+        // Visits matches [mBegin, mEnd) only, so ranges of the view can be
+        // processed on different threads.
+        template <typename TF>
+        void each(std::size_t mBegin, std::size_t mEnd, TF&& mFn);
     };
 
-    struct CRectangle : Component
+    // Sparse-set entity registry. Entity slots are recycled through a free
+    // list; live entities are kept packed in `alive` and removed from it,
+    // from their groups and from the component pools by swap-and-pop.
+    class EntityContainer
     {
-        RectangleShape shape;
-        Vector2f size;
+    private:
+        std::vector<Internal::EntityRecord> records;
+        std::vector<EntityIndex> alive;
+        std::vector<EntityIndex> freeIndices;
+        std::array<Internal::EntitySet, maxGroups> groupedEntities;
+
+        // Structural changes recorded since the last refresh(), so that
+        // refresh() only touches the entities that actually changed.
+        std::vector<EntityIndex> pendingDestroy;
+        std::vector<std::pair<EntityIndex, Group>> pendingGroupRemovals;
 
-        CRectangle(const Vector2f& mHalfSize, sf::Color color)
-                : size{mHalfSize * 2.f}
+        std::vector<std::unique_ptr<Internal::ViewCache>> views;
+
+        std::vector<Entity> instantiated;
+        std::array<std::unique_ptr<Internal::ComponentPoolBase>, maxComponents>
+                pools;
+
+    public:
+        // Makes room for `mCount` live entities in total.
+        void reserve(std::size_t mCount)
         {
-            shape.setFillColor(color);
+            Internal::reserveAmortized(records, mCount);
+            Internal::reserveAmortized(alive, mCount);
+            Internal::reserveAmortized(freeIndices, mCount);
+            Internal::reserveAmortized(pendingDestroy, mCount);
         }
 
-        void init() override
+        // Destroys every entity at once, e.g. on level reset. All handles
+        // become stale; entity slots and component slabs are kept for the
+        // next level.
+        void clear()
         {
-            shape.setSize(size);
-            shape.setOrigin(size.x / 2.f, size.y / 2.f);
+            for(auto& p : pools)
+                if(p) p->clear();
+
+            for(auto& g : groupedEntities) g.clear();
+            for(auto& v : views) v->entities.clear();
+
+            for(auto index : alive)
+            {
+                auto& record(records[index]);
+                ++record.generation;
+                record.alive = false;
+                record.componentBitset.reset();
+                record.groupBitset.reset();
+                record.groupMembership.reset();
+                freeIndices.emplace_back(index);
+            }
+
+            alive.clear();
+            pendingDestroy.clear();
+            pendingGroupRemovals.clear();
         }
 
-        CPosition* Position() const
+        std::size_t getEntityCount() const noexcept { return alive.size(); }
+
+        Entity createEntity()
         {
-            return &entity->getComponent<CPosition>();
+            EntityIndex index;
+            if(freeIndices.empty())
+            {
+                index = static_cast<EntityIndex>(records.size());
+                records.emplace_back();
+            }
+            else
+            {
+                index = freeIndices.back();
+                freeIndices.pop_back();
+            }
+
+            auto& record(records[index]);
+            record.alive = true;
+            record.denseIndex = alive.size();
+            record.componentBitset.reset();
+            record.groupBitset.reset();
+            record.groupMembership.reset();
+            alive.emplace_back(index);
+
+            return Entity{*this, EntityID{index, record.generation}};
         }
 
-        void update(float mFT) override
+        bool isValid(EntityID mID) const noexcept
         {
-            shape.setPosition(Position()->position);
+            return mID.index < records.size() &&
+                   records[mID.index].generation == mID.generation;
         }
 
-        void draw(sf::RenderWindow& renderWindow) override
+        bool isAlive(EntityID mID) const noexcept
         {
-            renderWindow.draw(shape);
+            return isValid(mID) && records[mID.index].alive;
         }
-    };
 
-    struct CPaddleControl : Component
-    {
-        CPhysics* Physics() const
+        void destroy(EntityID mID)
         {
-            return &entity->getComponent<CPhysics>();
+            if(!isAlive(mID)) return;
+
+            records[mID.index].alive = false;
+            pendingDestroy.emplace_back(mID.index);
         }
 
-        void update(FrameTime mFT) override
+        Internal::EntityRecord& getRecord(EntityIndex mIndex) noexcept
         {
-            auto cPhysics =  Physics();
-            if(Keyboard::isKeyPressed(Keyboard::Key::Left) &&
-               cPhysics->left() > 0)
-                cPhysics->velocity.x = -paddleVelocity;
-            else if(Keyboard::isKeyPressed(Keyboard::Key::Right) &&
-                    cPhysics->right() < windowWidth)
-                cPhysics->velocity.x = paddleVelocity;
-            else
-                cPhysics->velocity.x = 0;
+            return records[mIndex];
         }
-    };
-
-    template <class T1, class T2>
-    bool isIntersecting(T1& mA, T2& mB) noexcept
-    {
-        return mA.right() >= mB.left() && mA.left() <= mB.right() &&
-               mA.bottom() >= mB.top() && mA.top() <= mB.bottom();
-    }
-
-    void testCollisionPaddleBall(Entity &mPaddle, Entity &mBall) noexcept
-    {
-        auto& cpPaddle(mPaddle.getComponent<CPhysics>());
-        auto& cpBall(mBall.getComponent<CPhysics>());
-
-        if(!isIntersecting(cpPaddle, cpBall)) return;
-
-        cpBall.velocity.y = -ballVelocity;
-        if(cpBall.x() < cpPaddle.x())
-            cpBall.velocity.x = -ballVelocity;
-        else
-            cpBall.velocity.x = ballVelocity;
-    }
 
-    void testCollisionBrickBall(Entity &mBrick, Entity &mBall) noexcept
-    {
-        auto& cpBrick(mBrick.getComponent<CPhysics>());
-        auto& cpBall(mBall.getComponent<CPhysics>());
+        template <typename T>
+        Internal::ComponentPool<T>& getPool()
+        {
+            auto& pool(pools[getComponentTypeID<T>()]);
+            if(pool == nullptr)
+                pool = std::make_unique<Internal::ComponentPool<T>>();
 
-        if(!isIntersecting(cpBrick, cpBall)) return;
-        mBrick.destroy();
+            return *static_cast<Internal::ComponentPool<T>*>(pool.get());
+        }
 
-        float overlapLeft{cpBall.right() - cpBrick.left()};
-        float overlapRight{cpBrick.right() - cpBall.left()};
-        float overlapTop{cpBall.bottom() - cpBrick.top()};
-        float overlapBottom{cpBrick.bottom() - cpBall.top()};
+        template <typename T, typename... TArgs>
+        T& addComponent(const Entity& mEntity, TArgs&&... mArgs)
+        {
+            auto& record(records[mEntity.getIndex()]);
+            assert(!record.componentBitset[getComponentTypeID<T>()]);
 
-        bool ballFromLeft(std::abs(overlapLeft) < std::abs(overlapRight));
-        bool ballFromTop(std::abs(overlapTop) < std::abs(overlapBottom));
+            auto& pool(getPool<T>());
+            auto index(pool.add(mEntity.getIndex(),
+                                std::forward<TArgs>(mArgs)...));
 
-        float minOverlapX{ballFromLeft ? overlapLeft : overlapRight};
-        float minOverlapY{ballFromTop ? overlapTop : overlapBottom};
+            record.componentIndices[getComponentTypeID<T>()] = index;
+            record.componentBitset[getComponentTypeID<T>()] = true;
 
-        if(std::abs(minOverlapX) < std::abs(minOverlapY))
-            cpBall.velocity.x = ballFromLeft ? -ballVelocity : ballVelocity;
-        else
-            cpBall.velocity.y = ballFromTop ? -ballVelocity : ballVelocity;
-    }
+            for(auto& v : views)
+                if(v->signature[getComponentTypeID<T>()] &&
+                   v->matches(record.componentBitset))
+                    v->entities.insert(mEntity);
 
-    enum ArkanoidGroup : std::size_t
-    {
-        GPaddle,
-        GBrick,
-        GBall
-    };
+            auto& component(pool.get(index));
+            component.entity = mEntity;
+            return component;
+        }
 
-    struct BallFactory
-    {
-        static void create(EntityContainer& container)
+        // Structural change: must not be called while iterating a view
+        // that includes T.
+        template <typename T>
+        void removeComponent(const Entity& mEntity)
         {
-            auto entity = std::make_unique<Entity>(container);
-
-            entity->addComponent<CPosition>(
-                    Vector2f{windowWidth / 2.f, windowHeight / 2.f});
-            entity->addComponent<CPhysics>(Vector2f{ballRadius, ballRadius});
-            entity->addComponent<CCircle>(ballRadius);
+            auto& record(records[mEntity.getIndex()]);
+            assert(record.componentBitset[getComponentTypeID<T>()]);
 
-            auto& cPhysics(entity->getComponent<CPhysics>());
-            cPhysics.velocity = Vector2f{-ballVelocity, -ballVelocity};
-            cPhysics.onOutOfBounds = [&cPhysics](const Vector2f& mSide)
-            {
-                if(mSide.x != 0.f)
-                    cPhysics.velocity.x =
-                            std::abs(cPhysics.velocity.x) * mSide.x;
+            for(auto& v : views)
+                if(v->signature[getComponentTypeID<T>()] &&
+                   v->matches(record.componentBitset))
+                    v->entities.erase(mEntity.getIndex());
 
-                if(mSide.y != 0.f)
-                    cPhysics.velocity.y =
-                            std::abs(cPhysics.velocity.y) * mSide.y;
-            };
+            removeComponent(mEntity.getIndex(), getComponentTypeID<T>());
+            record.componentBitset[getComponentTypeID<T>()] = false;
+        }
 
-            entity->addGroup(ArkanoidGroup::GBall);
+        // Creates `mCount` copies of `mPrefab`, copying each component type
+        // in bulk, then calls `mOverride(entity, i)` for per-instance setup.
+        template <typename TF>
+        void instantiate(const Prefab& mPrefab, std::size_t mCount,
+                         TF&& mOverride);
 
-            container.addEntity(std::move(entity));
+        template <typename T>
+        T& getComponent(EntityIndex mIndex)
+        {
+            const auto& record(records[mIndex]);
+            assert(record.componentBitset[getComponentTypeID<T>()]);
+            return getPool<T>().get(
+                    record.componentIndices[getComponentTypeID<T>()]);
         }
-    };
 
-    struct BrickFactory
-    {
-        static void create(EntityContainer& container, const Vector2f& mPosition)
+        void addToGroup(const Entity& mEntity, Group mGroup)
         {
-            Vector2f halfSize{blockWidth / 2.f, blockHeight / 2.f};
-            auto entity = std::make_unique<Entity>(container);
-
-            entity->addComponent<CPosition>(mPosition);
-            entity->addComponent<CPhysics>(halfSize);
-            entity->addComponent<CRectangle>(halfSize, sf::Color::Yellow);
+            auto& record(records[mEntity.getIndex()]);
+            record.groupBitset[mGroup] = true;
+            if(record.groupMembership[mGroup]) return;
 
-            entity->addGroup(ArkanoidGroup::GBrick);
-
-            container.addEntity(std::move(entity));
+            record.groupMembership[mGroup] = true;
+            groupedEntities[mGroup].insert(mEntity);
         }
-    };
 
-    struct PaddleFactory
-    {
-        static void create(EntityContainer& container)
+        // Takes effect on the next refresh(), so groups being iterated
+        // during a step stay stable.
+        void removeFromGroup(const Entity& mEntity, Group mGroup)
         {
-            Vector2f halfSize{paddleWidth / 2.f, paddleHeight / 2.f};
-            auto entity = std::make_unique<Entity>(container);
+            auto& record(records[mEntity.getIndex()]);
+            if(!record.groupBitset[mGroup]) return;
 
-            entity->addComponent<CPosition>(
-                    Vector2f{windowWidth / 2.f, windowHeight - 60.f});
-            entity->addComponent<CPhysics>(halfSize);
-            entity->addComponent<CRectangle>(halfSize, sf::Color::Red);
-            entity->addComponent<CPaddleControl>();
-
-            entity->addGroup(ArkanoidGroup::GPaddle);
+            record.groupBitset[mGroup] = false;
+            pendingGroupRemovals.emplace_back(mEntity.getIndex(), mGroup);
+        }
 
-            container.addEntity(std::move(entity));
+        std::vector<Entity>& getEntitiesByGroup(Group mGroup)
+        {
+            return groupedEntities[mGroup].getEntities();
         }
-    };
 
-    struct Game
-    {
-        RenderWindow window{{windowWidth, windowHeight}, "Arkanoid"};
-        FrameTime lastFt{0.f}, currentSlice{0.f};
-        bool running{false};
-        EntityContainer container;
+        // Cached query over every entity owning all of `Ts...`. The first
+        // call for a signature builds the cache; afterwards it is kept up
+        // to date incrementally and lookups are a short linear search.
+        template <typename... Ts>
+        View<Ts...> view();
 
-        Game()
+        template <typename... Ts, typename TF>
+        void each(TF&& mFn)
         {
-            window.setFramerateLimit(240);
-
-            PaddleFactory::create(container);
-            BallFactory::create(container);
+            view<Ts...>().each(std::forward<TF>(mFn));
+        }
 
-            for(int iX{0}; iX < countBlocksX; ++iX)
+        void refresh()
+        {
+            for(const auto& change : pendingGroupRemovals)
             {
-                for (int iY{0}; iY < countBlocksY; ++iY)
-                {
-                    auto position = Vector2f{(iX + 1) * (blockWidth + 3) + 22,
-                                             (iY + 2) * (blockHeight + 3)};
+                auto& record(records[change.first]);
+                if(!record.alive || record.groupBitset[change.second] ||
+                   !record.groupMembership[change.second])
+                    continue;
 
-                    BrickFactory::create(container, position);
-                }
+                record.groupMembership[change.second] = false;
+                groupedEntities[change.second].erase(change.first);
             }
+            pendingGroupRemovals.clear();
+
+            for(auto index : pendingDestroy) release(index);
+            pendingDestroy.clear();
         }
 
-        void run()
+    private:
+        void removeComponent(EntityIndex mIndex, ComponentID mID)
         {
-            running = true;
-
-            while(running)
-            {
-                auto timePoint1(chrono::high_resolution_clock::now());
+            auto componentIndex(records[mIndex].componentIndices[mID]);
+            auto moved(pools[mID]->remove(componentIndex));
+            if(moved != invalidEntityIndex)
+                records[moved].componentIndices[mID] = componentIndex;
+        }
 
-                window.clear(Color::Black);
+        void release(EntityIndex mIndex)
+        {
+            auto& record(records[mIndex]);
 
-                inputPhase();
-                updatePhase();
-                drawPhase();
+            for(auto i(0u); i < maxGroups; ++i)
+                if(record.groupMembership[i]) groupedEntities[i].erase(mIndex);
 
-                auto timePoint2(chrono::high_resolution_clock::now());
-                auto elapsedTime(timePoint2 - timePoint1);
-                FrameTime ft{
-                        chrono::duration_cast<chrono::duration<float, milli>>(
-                                elapsedTime)
-                                .count()};
+            for(auto& v : views)
+                if(v->matches(record.componentBitset))
+                    v->entities.erase(mIndex);
 
-                lastFt = ft;
-            }
-        }
+            for(auto i(0u); i < maxComponents; ++i)
+                if(record.componentBitset[i]) removeComponent(mIndex, i);
 
-        void inputPhase()
-        {
-            Event event;
-            while(window.pollEvent(event))
-            {
-                if(event.type == Event::Closed)
-                {
-                    window.close();
-                    break;
-                }
-            }
+            alive[record.denseIndex] = alive.back();
+            records[alive[record.denseIndex]].denseIndex = record.denseIndex;
+            alive.pop_back();
 
-            if(Keyboard::isKeyPressed(Keyboard::Key::Escape)) running = false;
+            ++record.generation;
+            record.componentBitset.reset();
+            record.groupBitset.reset();
+            record.groupMembership.reset();
+            freeIndices.emplace_back(mIndex);
         }
+    };
 
-        void updatePhase()
+    inline bool Entity::isAlive() const
+    {
+        return container != nullptr && container->isAlive(id);
+    }
+
+    inline void Entity::destroy() { container->destroy(id); }
+
+    template <typename T>
+    bool Entity::hasComponent() const
+    {
+        return container->getRecord(id.index)
+                .componentBitset[getComponentTypeID<T>()];
+    }
+
+    inline bool Entity::hasGroup(Group mGroup) const noexcept
+    {
+        return container->getRecord(id.index).groupBitset[mGroup];
+    }
+
+    inline void Entity::addGroup(Group mGroup) noexcept
+    {
+        container->addToGroup(*this, mGroup);
+    }
+
+    inline void Entity::delGroup(Group mGroup) noexcept
+    {
+        container->removeFromGroup(*this, mGroup);
+    }
+
+    template <typename T, typename... TArgs>
+    void Entity::addComponent(TArgs&&... mArgs)
+    {
+        container->addComponent<T>(*this, std::forward<TArgs>(mArgs)...);
+    }
+
+    template <typename T>
+    T& Entity::getComponent() const
+    {
+        return container->getComponent<T>(id.index);
+    }
+
+    template <typename T>
+    void Entity::removeComponent()
+    {
+        container->removeComponent<T>(*this);
+    }
+
+    template <typename... Ts>
+    View<Ts...>::View(EntityContainer& mContainer,
+                      Internal::ViewCache& mCache)
+            : container(&mContainer), cache(&mCache),
+              pools(&mContainer.template getPool<Ts>()...)
+    {
+    }
+
+    template <typename... Ts>
+    template <typename TF>
+    void View<Ts...>::each(std::size_t mBegin, std::size_t mEnd, TF&& mFn)
+    {
+        eachIn(mBegin, mEnd, mFn,
+               *std::get<Internal::ComponentPool<Ts>*>(pools)...);
+    }
+
+    template <typename... Ts>
+    template <typename TF, typename T>
+    void View<Ts...>::eachIn(std::size_t mBegin, std::size_t mEnd, TF& mFn,
+                             Internal::ComponentPool<T>& mPool)
+    {
+        assert(mPool.size() == size());
+        for(auto i(mBegin); i < mEnd; ++i) mFn(mPool.get(i));
+    }
+
+    template <typename... Ts>
+    template <typename TF, typename... TPools>
+    void View<Ts...>::eachIn(std::size_t mBegin, std::size_t mEnd, TF& mFn,
+                             TPools&... mPools)
+    {
+        auto& entities(cache->entities.getEntities());
+        for(auto i(mBegin); i < mEnd; ++i)
+        {
+            const auto& indices(
+                    container->getRecord(entities[i].getIndex())
+                            .componentIndices);
+            mFn(mPools.get(indices[getComponentTypeID<Ts>()])...);
+        }
+    }
+
+    template <typename... Ts>
+    View<Ts...> EntityContainer::view()
+    {
+        constexpr auto signature(getSignature<Ts...>());
+
+        for(auto& v : views)
+            if(v->signature == signature) return View<Ts...>{*this, *v};
+
+        auto cache(std::make_unique<Internal::ViewCache>());
+        cache->signature = signature;
+        for(auto index : alive)
+        {
+            const auto& record(records[index]);
+            if(cache->matches(record.componentBitset))
+                cache->entities.insert(
+                        Entity{*this, EntityID{index, record.generation}});
+        }
+
+        views.emplace_back(std::move(cache));
+        return View<Ts...>{*this, *views.back()};
+    }
+
+    template <typename TSystem, typename... TComponents>
+    template <typename... TArgs>
+    void Internal::SystemRunner<TSystem, TypeList<TComponents...>>::run(
+            EntityContainer& mContainer, TSystem& mSystem, TArgs&&... mArgs)
+    {
+        mContainer.each<TComponents...>([&](TComponents&... mComponents)
+            {
+                mSystem(mComponents..., mArgs...);
+            });
+    }
+
+    namespace Internal
+    {
+        struct PrototypeBase
+        {
+            // Appends one copy of the prototype per entity in `mEntities`
+            // and returns the pool index of the first copy.
+            virtual std::size_t instantiate(
+                    EntityContainer& mContainer,
+                    const std::vector<Entity>& mEntities) const = 0;
+
+            virtual ~PrototypeBase() {}
+        };
+
+        template <typename T>
+        struct Prototype : PrototypeBase
+        {
+            T component;
+
+            template <typename... TArgs>
+            Prototype(TArgs&&... mArgs)
+                    : component(std::forward<TArgs>(mArgs)...)
+            {
+            }
+
+            std::size_t instantiate(
+                    EntityContainer& mContainer,
+                    const std::vector<Entity>& mEntities) const override
+            {
+                auto& pool(mContainer.getPool<T>());
+                auto first(pool.append(component, mEntities.size(),
+                                       [&mEntities](std::size_t mI)
+                                       {
+                                           return mEntities[mI].getIndex();
+                                       }));
+
+                for(std::size_t i{0}; i < mEntities.size(); ++i)
+                    pool.get(first + i).entity = mEntities[i];
+
+                return first;
+            }
+        };
+    }
+
+    // Entity template: components and groups are built once, then
+    // EntityContainer::instantiate() copies them in bulk into the pools.
+    class Prefab
+    {
+        friend class EntityContainer;
+
+    private:
+        ComponentBitset signature;
+        GroupBitset groups;
+        std::array<std::unique_ptr<Internal::PrototypeBase>, maxComponents>
+                prototypes;
+
+    public:
+        template <typename T, typename... TArgs>
+        T& addComponent(TArgs&&... mArgs)
+        {
+            assert(!signature[getComponentTypeID<T>()]);
+
+            auto prototype(std::make_unique<Internal::Prototype<T>>(
+                    std::forward<TArgs>(mArgs)...));
+            auto& component(prototype->component);
+
+            prototypes[getComponentTypeID<T>()] = std::move(prototype);
+            signature[getComponentTypeID<T>()] = true;
+            return component;
+        }
+
+        void addGroup(Group mGroup) noexcept { groups[mGroup] = true; }
+    };
+
+    template <typename TF>
+    void EntityContainer::instantiate(const Prefab& mPrefab, std::size_t mCount,
+                                      TF&& mOverride)
+    {
+        reserve(alive.size() + mCount);
+
+        instantiated.clear();
+        for(std::size_t i{0}; i < mCount; ++i)
+            instantiated.emplace_back(createEntity());
+
+        for(auto id(0u); id < maxComponents; ++id)
+        {
+            if(!mPrefab.signature[id]) continue;
+
+            auto first(
+                    mPrefab.prototypes[id]->instantiate(*this, instantiated));
+            for(std::size_t i{0}; i < mCount; ++i)
+                records[instantiated[i].getIndex()].componentIndices[id] =
+                        first + i;
+        }
+
+        for(const auto& e : instantiated)
+            records[e.getIndex()].componentBitset = mPrefab.signature;
+
+        for(auto& v : views)
+            if(v->matches(mPrefab.signature))
+                for(const auto& e : instantiated) v->entities.insert(e);
+
+        for(auto group(0u); group < maxGroups; ++group)
+            if(mPrefab.groups[group])
+                for(const auto& e : instantiated) addToGroup(e, group);
+
+        for(std::size_t i{0}; i < mCount; ++i) mOverride(instantiated[i], i);
+    }
+
+    class CommandBuffer;
+
+    // Entity recorded in a CommandBuffer; it is created on flush().
+    class PendingEntity
+    {
+    private:
+        CommandBuffer* buffer;
+        std::size_t index;
+
+    public:
+        PendingEntity(CommandBuffer& mBuffer, std::size_t mIndex)
+                : buffer(&mBuffer), index(mIndex)
+        {
+        }
+
+        std::size_t getIndex() const noexcept { return index; }
+
+        template <typename T, typename... TArgs>
+        void addComponent(TArgs&&... mArgs);
+
+        void addGroup(Group mGroup);
+    };
+
+    namespace Internal
+    {
+        // Either a live entity or one created by the same flush().
+        struct CommandTarget
+        {
+            static constexpr std::size_t existing{
+                    std::numeric_limits<std::size_t>::max()};
+
+            Entity entity;
+            std::size_t pending{existing};
+
+            Entity resolve(const std::vector<Entity>& mCreated) const
+            {
+                return pending == existing ? entity : mCreated[pending];
+            }
+        };
+
+        struct StagedComponentsBase
+        {
+            virtual void apply(EntityContainer& mContainer,
+                               const std::vector<Entity>& mCreated) = 0;
+            virtual void clear() noexcept = 0;
+
+            virtual ~StagedComponentsBase() {}
+        };
+
+        template <typename T>
+        struct StagedComponents : StagedComponentsBase
+        {
+            std::vector<std::pair<CommandTarget, T>> entries;
+
+            void apply(EntityContainer& mContainer,
+                       const std::vector<Entity>& mCreated) override
+            {
+                auto& pool(mContainer.getPool<T>());
+                pool.reserve(pool.size() + entries.size());
+
+                for(auto& e : entries)
+                {
+                    auto entity(e.first.resolve(mCreated));
+                    if(!entity.isAlive()) continue;
+
+                    mContainer.addComponent<T>(entity, std::move(e.second));
+                }
+            }
+
+            void clear() noexcept override { entries.clear(); }
+        };
+    }
+
+    // Records structural changes (creation, destruction, component and group
+    // additions) so they can be requested while systems run or groups are
+    // iterated, then applies them in one batch at a sync point. Recording is
+    // thread-safe; flush() must not overlap with recording. Components are
+    // applied per type, and each pool and the entity tables reserve room for
+    // the whole batch with amortized growth before it is applied.
+    class CommandBuffer
+    {
+    private:
+        std::mutex mutex;
+        std::size_t pendingCount{0};
+        std::array<std::unique_ptr<Internal::StagedComponentsBase>,
+                   maxComponents>
+                staged;
+        std::vector<std::pair<Internal::CommandTarget, Group>> groupAdds;
+        std::vector<Entity> destroys;
+        std::vector<Entity> created;
+
+        template <typename T>
+        Internal::StagedComponents<T>& getStaged()
+        {
+            auto& s(staged[getComponentTypeID<T>()]);
+            if(s == nullptr)
+                s = std::make_unique<Internal::StagedComponents<T>>();
+
+            return *static_cast<Internal::StagedComponents<T>*>(s.get());
+        }
+
+        template <typename T, typename... TArgs>
+        void stageComponent(const Internal::CommandTarget& mTarget,
+                            TArgs&&... mArgs)
+        {
+            std::lock_guard<std::mutex> lock{mutex};
+            getStaged<T>().entries.emplace_back(
+                    std::piecewise_construct, std::forward_as_tuple(mTarget),
+                    std::forward_as_tuple(std::forward<TArgs>(mArgs)...));
+        }
+
+        void stageGroup(const Internal::CommandTarget& mTarget, Group mGroup)
+        {
+            std::lock_guard<std::mutex> lock{mutex};
+            groupAdds.emplace_back(mTarget, mGroup);
+        }
+
+    public:
+        PendingEntity createEntity()
+        {
+            std::lock_guard<std::mutex> lock{mutex};
+            return PendingEntity{*this, pendingCount++};
+        }
+
+        void destroy(const Entity& mEntity)
+        {
+            std::lock_guard<std::mutex> lock{mutex};
+            destroys.emplace_back(mEntity);
+        }
+
+        template <typename T, typename... TArgs>
+        void addComponent(const PendingEntity& mEntity, TArgs&&... mArgs)
+        {
+            stageComponent<T>(
+                    Internal::CommandTarget{Entity{}, mEntity.getIndex()},
+                    std::forward<TArgs>(mArgs)...);
+        }
+
+        template <typename T, typename... TArgs>
+        void addComponent(const Entity& mEntity, TArgs&&... mArgs)
+        {
+            stageComponent<T>(Internal::CommandTarget{mEntity},
+                              std::forward<TArgs>(mArgs)...);
+        }
+
+        void addGroup(const PendingEntity& mEntity, Group mGroup)
+        {
+            stageGroup(Internal::CommandTarget{Entity{}, mEntity.getIndex()},
+                       mGroup);
+        }
+
+        void addGroup(const Entity& mEntity, Group mGroup)
+        {
+            stageGroup(Internal::CommandTarget{mEntity}, mGroup);
+        }
+
+        void flush(EntityContainer& mContainer)
+        {
+            created.clear();
+            Internal::reserveAmortized(created, pendingCount);
+            mContainer.reserve(mContainer.getEntityCount() + pendingCount);
+            for(std::size_t i{0}; i < pendingCount; ++i)
+                created.emplace_back(mContainer.createEntity());
+
+            for(auto& s : staged)
+                if(s != nullptr)
+                {
+                    s->apply(mContainer, created);
+                    s->clear();
+                }
+
+            for(const auto& g : groupAdds)
+            {
+                auto entity(g.first.resolve(created));
+                if(entity.isAlive()) entity.addGroup(g.second);
+            }
+
+            for(auto& e : destroys) e.destroy();
+
+            pendingCount = 0;
+            groupAdds.clear();
+            destroys.clear();
+        }
+    };
+
+    template <typename T, typename... TArgs>
+    void PendingEntity::addComponent(TArgs&&... mArgs)
+    {
+        buffer->addComponent<T>(*this, std::forward<TArgs>(mArgs)...);
+    }
+
+    inline void PendingEntity::addGroup(Group mGroup)
+    {
+        buffer->addGroup(*this, mGroup);
+    }
+
+    // Work-stealing thread pool. Every worker owns a task deque: it pops
+    // its own tasks LIFO and steals the oldest tasks of the others when it
+    // runs dry. Tasks are plain function pointers over an index range, so
+    // submitting work never allocates beyond the deques themselves.
+    class ThreadPool
+    {
+    public:
+        struct Task
+        {
+            void (*run)(void*, std::size_t, std::size_t);
+            void* context;
+            std::size_t begin, end;
+        };
+
+    private:
+        struct Queue
+        {
+            std::mutex mutex;
+            std::deque<Task> tasks;
+        };
+
+        // Queue 0 belongs to threads outside the pool (the main thread).
+        std::vector<std::unique_ptr<Queue>> queues;
+        std::vector<std::thread> workers;
+        std::atomic<std::size_t> queued{0};
+        std::atomic<bool> stopping{false};
+        std::mutex sleepMutex;
+        std::condition_variable wake;
+
+        static std::size_t& currentQueue() noexcept
+        {
+            static thread_local std::size_t index{0};
+            return index;
+        }
+
+        bool tryPop(std::size_t mSelf, Task& mTask)
+        {
+            {
+                auto& own(*queues[mSelf]);
+                std::lock_guard<std::mutex> lock{own.mutex};
+                if(!own.tasks.empty())
+                {
+                    mTask = own.tasks.back();
+                    own.tasks.pop_back();
+                    --queued;
+                    return true;
+                }
+            }
+
+            for(std::size_t i{1}; i < queues.size(); ++i)
+            {
+                auto& victim(*queues[(mSelf + i) % queues.size()]);
+                std::lock_guard<std::mutex> lock{victim.mutex};
+                if(victim.tasks.empty()) continue;
+
+                mTask = victim.tasks.front();
+                victim.tasks.pop_front();
+                --queued;
+                return true;
+            }
+
+            return false;
+        }
+
+        void work(std::size_t mSelf)
+        {
+            currentQueue() = mSelf;
+
+            while(!stopping)
+            {
+                Task task;
+                if(tryPop(mSelf, task))
+                {
+                    task.run(task.context, task.begin, task.end);
+                    continue;
+                }
+
+                std::unique_lock<std::mutex> lock{sleepMutex};
+                wake.wait(lock, [this]
+                          {
+                              return stopping || queued > 0;
+                          });
+            }
+        }
+
+    public:
+        // One worker per extra hardware thread: the thread that waits on
+        // the pool helps running tasks.
+        static std::size_t getDefaultWorkerCount() noexcept
+        {
+            auto threads(std::thread::hardware_concurrency());
+            return threads > 1 ? threads - 1 : 0;
+        }
+
+        explicit ThreadPool(std::size_t mWorkers = getDefaultWorkerCount())
+        {
+            for(std::size_t i{0}; i <= mWorkers; ++i)
+                queues.emplace_back(std::make_unique<Queue>());
+
+            for(std::size_t i{1}; i <= mWorkers; ++i)
+                workers.emplace_back([this, i]
+                                     {
+                                         work(i);
+                                     });
+        }
+
+        ThreadPool(const ThreadPool&) = delete;
+        ThreadPool& operator=(const ThreadPool&) = delete;
+
+        ~ThreadPool()
+        {
+            {
+                std::lock_guard<std::mutex> lock{sleepMutex};
+                stopping = true;
+            }
+            wake.notify_all();
+
+            for(auto& w : workers) w.join();
+        }
+
+        std::size_t getWorkerCount() const noexcept { return workers.size(); }
+
+        void submit(const Task& mTask)
+        {
+            auto& queue(*queues[currentQueue()]);
+            {
+                std::lock_guard<std::mutex> lock{queue.mutex};
+                queue.tasks.emplace_back(mTask);
+            }
+
+            {
+                std::lock_guard<std::mutex> lock{sleepMutex};
+                ++queued;
+            }
+            wake.notify_one();
+        }
+
+        // Runs queued tasks on the calling thread until `mDone()` holds.
+        template <typename TF>
+        void helpUntil(TF mDone)
+        {
+            while(!mDone())
+            {
+                Task task;
+                if(tryPop(currentQueue(), task))
+                    task.run(task.context, task.begin, task.end);
+                else
+                    std::this_thread::yield();
+            }
+        }
+
+        // Runs `mFn(begin, end)` over [0, mCount) in chunks of at most
+        // `mChunkSize` indices and returns once every chunk has run.
+        template <typename TF>
+        void parallelFor(std::size_t mCount, std::size_t mChunkSize, TF& mFn)
+        {
+            if(mCount <= mChunkSize)
+            {
+                if(mCount > 0) mFn(0, mCount);
+                return;
+            }
+
+            struct Context
+            {
+                TF* fn;
+                std::atomic<std::size_t> pending;
+            } context;
+
+            context.fn = &mFn;
+            context.pending = (mCount + mChunkSize - 1) / mChunkSize;
+
+            for(std::size_t i{0}; i < mCount; i += mChunkSize)
+                submit(Task{[](void* mContext, std::size_t mBegin,
+                               std::size_t mEnd)
+                            {
+                                auto& c(*static_cast<Context*>(mContext));
+                                (*c.fn)(mBegin, mEnd);
+                                --c.pending;
+                            },
+                            &context, i, std::min(mCount, i + mChunkSize)});
+
+            helpUntil([&context]
+                      {
+                          return context.pending == 0;
+                      });
+        }
+    };
+
+    namespace Internal
+    {
+        template <typename TList>
+        struct ListSignature;
+
+        template <typename... Ts>
+        struct ListSignature<TypeList<Ts...>>
+        {
+            static constexpr ComponentBitset get() noexcept
+            {
+                return getSignature<Ts...>();
+            }
+        };
+
+        struct ScheduleState;
+
+        // Which systems of a schedule must finish before which others. It
+        // only depends on the systems' Reads and Writes, so each schedule
+        // builds it once.
+        template <std::size_t TCount>
+        struct ScheduleGraph
+        {
+            std::array<std::vector<std::size_t>, TCount> dependents;
+            std::array<std::size_t, TCount> dependencies{};
+            std::vector<std::size_t> roots;
+        };
+
+        struct ScheduleNode
+        {
+            ScheduleState* state;
+            const std::vector<std::size_t>* dependents;
+            std::atomic<std::size_t> dependencies{0}, chunksLeft{0};
+
+            void* job;
+            std::size_t (*jobSize)(void*);
+            void (*runJob)(void*, std::size_t, std::size_t);
+        };
+
+        struct ScheduleState
+        {
+            ThreadPool* pool;
+            std::size_t chunkSize;
+            ScheduleNode* nodes;
+            std::atomic<std::size_t> completed{0};
+
+            void launch(ScheduleNode& mNode)
+            {
+                auto size(mNode.jobSize(mNode.job));
+                if(size == 0)
+                {
+                    complete(mNode);
+                    return;
+                }
+
+                auto chunks((size + chunkSize - 1) / chunkSize);
+                mNode.chunksLeft = chunks;
+
+                for(std::size_t i{0}; i < chunks; ++i)
+                    pool->submit(ThreadPool::Task{
+                            &ScheduleState::runChunk, &mNode, i * chunkSize,
+                            std::min(size, (i + 1) * chunkSize)});
+            }
+
+            void complete(ScheduleNode& mNode)
+            {
+                for(auto d : *mNode.dependents)
+                    if(--nodes[d].dependencies == 0) launch(nodes[d]);
+
+                ++completed;
+            }
+
+            static void runChunk(void* mNode, std::size_t mBegin,
+                                 std::size_t mEnd)
+            {
+                auto& node(*static_cast<ScheduleNode*>(mNode));
+                node.runJob(node.job, mBegin, mEnd);
+
+                if(--node.chunksLeft == 0) node.state->complete(node);
+            }
+        };
+
+        template <typename TSystem, typename TSignature, typename TArgs>
+        struct ScheduledJob;
+
+        template <typename TSystem, typename... TComponents, typename TArgs>
+        struct ScheduledJob<TSystem, TypeList<TComponents...>, TArgs>
+        {
+            TSystem system;
+            View<TComponents...> view;
+            TArgs* args;
+
+            static std::size_t size(void* mJob)
+            {
+                return static_cast<ScheduledJob*>(mJob)->view.size();
+            }
+
+            static void run(void* mJob, std::size_t mBegin, std::size_t mEnd)
+            {
+                auto& job(*static_cast<ScheduledJob*>(mJob));
+                job.runRange(mBegin, mEnd,
+                             std::make_index_sequence<
+                                     std::tuple_size<TArgs>::value>{});
+            }
+
+            template <std::size_t... TIndices>
+            void runRange(std::size_t mBegin, std::size_t mEnd,
+                          std::index_sequence<TIndices...>)
+            {
+                view.each(mBegin, mEnd,
+                          [this](TComponents&... mComponents)
+                          {
+                              system(mComponents...,
+                                     std::get<TIndices>(*args)...);
+                          });
+            }
+        };
+    }
+
+    // Runs a compile-time list of systems on a ThreadPool. Each system may
+    // declare `Reads` and `Writes` typelists (by default it writes its whole
+    // signature). Two systems conflict when one writes a component the
+    // other touches; conflicting systems run in declaration order, all
+    // others run concurrently. Every system's entities are further split
+    // into chunks, so its operator() must be safe to call concurrently for
+    // distinct entities.
+    template <typename... TSystems>
+    struct SystemSchedule
+    {
+        static constexpr std::size_t chunkSize{1024};
+
+        template <typename... TArgs>
+        static void run(EntityContainer& mContainer, ThreadPool& mPool,
+                        TArgs&&... mArgs)
+        {
+            auto args(std::forward_as_tuple(mArgs...));
+            const auto& graph(getGraph());
+
+            // Per-step state lives on the stack; nothing is allocated here.
+            std::array<Internal::ScheduleNode, systemCount> nodes;
+            Internal::ScheduleState state;
+            state.pool = &mPool;
+            state.chunkSize = chunkSize;
+            state.nodes = nodes.data();
+
+            // Views are resolved up front: building a view's cache is a
+            // structural change and must not race with running systems.
+            auto jobs(std::make_tuple(makeJob<TSystems>(mContainer, args)...));
+            initNodes(state, graph, jobs,
+                      std::make_index_sequence<systemCount>{});
+
+            // Roots come from the graph, not from the live counters: once
+            // launched, a root may complete and launch its dependents from
+            // a worker thread.
+            for(auto i : graph.roots) state.launch(nodes[i]);
+
+            mPool.helpUntil([&state]
+                            {
+                                return state.completed == systemCount;
+                            });
+        }
+
+    private:
+        static constexpr std::size_t systemCount{sizeof...(TSystems)};
+        using Graph = Internal::ScheduleGraph<systemCount>;
+
+        static const Graph& getGraph()
+        {
+            static const Graph graph{makeGraph()};
+            return graph;
+        }
+
+        static Graph makeGraph()
+        {
+            std::array<ComponentBitset, systemCount> reads{
+                    {Internal::ListSignature<
+                            typename TSystems::Reads>::get()...}};
+            std::array<ComponentBitset, systemCount> writes{
+                    {Internal::ListSignature<
+                            typename TSystems::Writes>::get()...}};
+
+            Graph graph;
+            for(std::size_t j{0}; j < systemCount; ++j)
+                for(std::size_t i{0}; i < j; ++i)
+                    if((writes[i] & (reads[j] | writes[j])).any() ||
+                       (reads[i] & writes[j]).any())
+                    {
+                        graph.dependents[i].emplace_back(j);
+                        ++graph.dependencies[j];
+                    }
+
+            for(std::size_t i{0}; i < systemCount; ++i)
+                if(graph.dependencies[i] == 0) graph.roots.emplace_back(i);
+
+            return graph;
+        }
+
+        template <typename TSystem, typename TArgs>
+        static auto makeJob(EntityContainer& mContainer, TArgs& mArgs)
+        {
+            using Signature = typename TSystem::Signature;
+            using Job = Internal::ScheduledJob<TSystem, Signature, TArgs>;
+            return Job{TSystem{}, makeView(mContainer, Signature{}), &mArgs};
+        }
+
+        template <typename... TComponents>
+        static View<TComponents...> makeView(EntityContainer& mContainer,
+                                             TypeList<TComponents...>)
+        {
+            return mContainer.view<TComponents...>();
+        }
+
+        template <typename TJobs, std::size_t... TIndices>
+        static void initNodes(Internal::ScheduleState& mState,
+                              const Graph& mGraph, TJobs& mJobs,
+                              std::index_sequence<TIndices...>)
+        {
+            using Expander = int[];
+            (void)Expander{0, (initNode(mState, mGraph, TIndices,
+                                        std::get<TIndices>(mJobs)),
+                               0)...};
+        }
+
+        template <typename TJob>
+        static void initNode(Internal::ScheduleState& mState,
+                             const Graph& mGraph, std::size_t mIndex,
+                             TJob& mJob)
+        {
+            auto& node(mState.nodes[mIndex]);
+            node.state = &mState;
+            node.dependents = &mGraph.dependents[mIndex];
+            node.dependencies = mGraph.dependencies[mIndex];
+            node.job = &mJob;
+            node.jobSize = &TJob::size;
+            node.runJob = &TJob::run;
+        }
+    };
+
+    // Hands the newest value from one producer thread to one consumer
+    // thread without locks. Neither side waits: the producer overwrites a
+    // value the consumer has not taken yet, and the consumer keeps its
+    // last value until a newer one is published.
+    template <typename T>
+    class TripleBuffer
+    {
+    private:
+        static constexpr std::uint8_t freshBit{4};
+
+        std::array<T, 3> slots;
+
+        // Slot between the two sides, plus `freshBit` while it holds a
+        // value the consumer has not taken.
+        std::atomic<std::uint8_t> middle{1};
+        std::uint8_t back{0}, front{2};
+
+        static std::uint8_t slotOf(std::uint8_t mState) noexcept
+        {
+            return static_cast<std::uint8_t>(mState & ~freshBit);
+        }
+
+    public:
+        explicit TripleBuffer(const T& mInitial)
+                : slots{{mInitial, mInitial, mInitial}}
+        {
+        }
+
+        // Producer side: fill the back value, then publish it.
+        T& getBack() noexcept { return slots[back]; }
+
+        void publish() noexcept
+        {
+            back = slotOf(middle.exchange(back | freshBit,
+                                          std::memory_order_acq_rel));
+        }
+
+        // Consumer side: takes the newest published value, if there is one
+        // it has not taken yet, and returns whether it did.
+        bool acquire() noexcept
+        {
+            if(!(middle.load(std::memory_order_relaxed) & freshBit))
+                return false;
+
+            front = slotOf(middle.exchange(front, std::memory_order_acq_rel));
+            return true;
+        }
+
+        const T& getFront() const noexcept { return slots[front]; }
+    };
+
+    using namespace std;
+    using namespace sf;
+    using FrameTime = float;
+
+    // Signed 16.16 fixed-point number. All arithmetic is done on integers,
+    // so results are bit-identical on every machine and with any compiler
+    // flags. Operations saturate instead of overflowing.
+    class Fixed
+    {
+    private:
+        static constexpr int fractionBits{16};
+        static constexpr std::int64_t one{std::int64_t{1} << fractionBits};
+        static constexpr std::int64_t maxRaw{
+                std::numeric_limits<std::int32_t>::max()};
+
+        std::int32_t raw{0};
+
+        static constexpr Fixed fromRaw(std::int64_t mRaw) noexcept
+        {
+            Fixed result;
+            result.raw = static_cast<std::int32_t>(
+                    mRaw > maxRaw ? maxRaw : mRaw < -maxRaw ? -maxRaw : mRaw);
+            return result;
+        }
+
+    public:
+        constexpr Fixed() noexcept = default;
+
+        // Only used for constants and for converting input; rounds to the
+        // nearest representable value.
+        constexpr Fixed(float mValue) noexcept
+                : raw{static_cast<std::int32_t>(mValue * one +
+                                                (mValue < 0.f ? -.5f : .5f))}
+        {
+        }
+
+        static constexpr Fixed max() noexcept
+        {
+            return fromRaw(maxRaw);
+        }
+
+        constexpr float toFloat() const noexcept
+        {
+            return static_cast<float>(raw) / one;
+        }
+
+        // Rounds towards negative infinity.
+        constexpr int floor() const noexcept { return raw >> fractionBits; }
+
+        friend constexpr Fixed operator+(Fixed mA, Fixed mB) noexcept
+        {
+            return fromRaw(std::int64_t{mA.raw} + mB.raw);
+        }
+
+        friend constexpr Fixed operator-(Fixed mA, Fixed mB) noexcept
+        {
+            return fromRaw(std::int64_t{mA.raw} - mB.raw);
+        }
+
+        friend constexpr Fixed operator*(Fixed mA, Fixed mB) noexcept
+        {
+            return fromRaw(std::int64_t{mA.raw} * mB.raw / one);
+        }
+
+        friend constexpr Fixed operator/(Fixed mA, Fixed mB) noexcept
+        {
+            return mB.raw == 0
+                           ? (mA.raw < 0 ? -max() : max())
+                           : fromRaw(std::int64_t{mA.raw} * one / mB.raw);
+        }
+
+        friend constexpr Fixed operator-(Fixed mA) noexcept
+        {
+            return fromRaw(-std::int64_t{mA.raw});
+        }
+
+        Fixed& operator+=(Fixed mB) noexcept { return *this = *this + mB; }
+        Fixed& operator-=(Fixed mB) noexcept { return *this = *this - mB; }
+        Fixed& operator*=(Fixed mB) noexcept { return *this = *this * mB; }
+        Fixed& operator/=(Fixed mB) noexcept { return *this = *this / mB; }
+
+        friend constexpr bool operator==(Fixed mA, Fixed mB) noexcept
+        {
+            return mA.raw == mB.raw;
+        }
+
+        friend constexpr bool operator!=(Fixed mA, Fixed mB) noexcept
+        {
+            return mA.raw != mB.raw;
+        }
+
+        friend constexpr bool operator<(Fixed mA, Fixed mB) noexcept
+        {
+            return mA.raw < mB.raw;
+        }
+
+        friend constexpr bool operator>(Fixed mA, Fixed mB) noexcept
+        {
+            return mA.raw > mB.raw;
+        }
+
+        friend constexpr bool operator<=(Fixed mA, Fixed mB) noexcept
+        {
+            return mA.raw <= mB.raw;
+        }
+
+        friend constexpr bool operator>=(Fixed mA, Fixed mB) noexcept
+        {
+            return mA.raw >= mB.raw;
+        }
+
+        friend Fixed absolute(Fixed mA) noexcept
+        {
+            return mA.raw < 0 ? -mA : mA;
+        }
+
+        // Integer square root of the raw value scaled by 2^16.
+        friend Fixed squareRoot(Fixed mA) noexcept
+        {
+            if(mA.raw <= 0) return Fixed{};
+
+            auto value(static_cast<std::uint64_t>(mA.raw) << fractionBits);
+            std::uint64_t result{0}, bit{std::uint64_t{1} << 62};
+
+            while(bit > value) bit >>= 2;
+            for(; bit != 0; bit >>= 2)
+            {
+                if(value >= result + bit)
+                {
+                    value -= result + bit;
+                    result = (result >> 1) + bit;
+                }
+                else
+                    result >>= 1;
+            }
+
+            return fromRaw(static_cast<std::int64_t>(result));
+        }
+    };
+
+    inline float absolute(float mA) noexcept { return std::abs(mA); }
+    inline float squareRoot(float mA) noexcept { return std::sqrt(mA); }
+    inline float toFloat(float mA) noexcept { return mA; }
+    inline float toFloat(Fixed mA) noexcept { return mA.toFloat(); }
+
+    inline int floorToInt(float mA) noexcept
+    {
+        return static_cast<int>(std::floor(mA));
+    }
+
+    inline int floorToInt(Fixed mA) noexcept { return mA.floor(); }
+
+    // Simulation scalar. Builds with ARKANOID_FIXED_POINT simulate in
+    // fixed point so that replays and lockstep peers stay in sync;
+    // rendering always converts back to float.
+#ifdef ARKANOID_FIXED_POINT
+    using Real = Fixed;
+    constexpr Real maxReal{Fixed::max()};
+
+    // Converting a larger float to Fixed overflows.
+    constexpr float maxCoordinate{32767.f};
+#else
+    using Real = float;
+    constexpr Real maxReal{std::numeric_limits<float>::max()};
+
+    // Past 2^24 a float can no longer hold every whole pixel.
+    constexpr float maxCoordinate{16777216.f};
+#endif
+
+    using Vec2 = Vector2<Real>;
+
+    template <typename T>
+    Vector2f toVector2f(const Vector2<T>& mV) noexcept
+    {
+        return Vector2f{toFloat(mV.x), toFloat(mV.y)};
+    }
+
+    constexpr int windowWidth{800}, windowHeight{600};
+    constexpr float ballRadius{10.f};
+    constexpr float paddleWidth{60.f}, paddleHeight{20.f};
+    constexpr float blockWidth{60.f}, blockHeight{20.f};
+    constexpr int countBlocksX{11}, countBlocksY{4};
+
+    // Broadphase cells span several bricks each, so that a cell holds
+    // enough bounds to fill the vector lanes of `overlapMask`.
+    constexpr float brickCellSize{4 * (blockWidth + 3)};
+
+    // Most lattice rows whose field still fits within maxCoordinate.
+    constexpr int maxBrickRows{
+            countBlocksY + static_cast<int>((maxCoordinate - windowHeight) /
+                                            (blockHeight + 3))};
+    constexpr Real ballVelocity{0.6f}, paddleVelocity{0.6f};
+
+    struct Game;
+
+    struct CPosition : Component
+    {
+        // `previous` is where the body was at the start of the current
+        // simulation step; rendering interpolates between the two.
+        Vec2 position, previous;
+
+        CPosition() = default;
+        CPosition(const Vec2& mPosition)
+                : position{mPosition}, previous{mPosition}
+        {
+        }
+
+        Real x() const noexcept { return position.x; }
+        Real y() const noexcept { return position.y; }
+    };
+
+    struct CPhysics : Component
+    {
+        Vec2 velocity, halfSize;
+
+        // Receives the body itself: pooled components move when another
+        // one is removed, so handlers must not capture a reference to it.
+        // A plain function pointer keeps spawning free of allocations.
+        using OutOfBoundsHandler = void (*)(CPhysics&, const Vec2&);
+        OutOfBoundsHandler onOutOfBounds{nullptr};
+
+        // Moved by the game's swept collision step instead of SPhysics.
+        bool continuous{false};
+
+        // Set by SPhysics while the body is at rest; a sleeping body skips
+        // integration and bounds checks until its velocity changes.
+        bool sleeping{false};
+
+        CPhysics(const Vec2& mHalfSize) : halfSize{mHalfSize} {}
+
+        CPosition* Position() const
+        {
+            return &entity.getComponent<CPosition>();
+        }
+
+        Real x() const noexcept { return Position()->x(); }
+        Real y() const noexcept { return Position()->y(); }
+        Real left() const noexcept { return x() - halfSize.x; }
+        Real right() const noexcept { return x() + halfSize.x; }
+        Real top() const noexcept { return y() - halfSize.y; }
+        Real bottom() const noexcept { return y() + halfSize.y; }
+    };
+
+    // Bounds of a body that never moves, such as a brick. Static bodies
+    // have no CPhysics, so they live in their own pool and SPhysics never
+    // visits them.
+    struct CStaticBody : Component
+    {
+        Vec2 halfSize;
+
+        CStaticBody(const Vec2& mHalfSize) : halfSize{mHalfSize} {}
+
+        CPosition* Position() const
+        {
+            return &entity.getComponent<CPosition>();
+        }
+
+        Real x() const noexcept { return Position()->x(); }
+        Real y() const noexcept { return Position()->y(); }
+        Real left() const noexcept { return x() - halfSize.x; }
+        Real right() const noexcept { return x() + halfSize.x; }
+        Real top() const noexcept { return y() - halfSize.y; }
+        Real bottom() const noexcept { return y() + halfSize.y; }
+    };
+
+    // Shapes are plain data centered on the entity's CPosition; the
+    // BatchRenderer turns them into vertices.
+    struct CCircle : Component
+    {
+        float radius;
+        Color color{Color::Red};
+
+        CCircle(float mRadius) : radius{mRadius} {}
+
+        FloatRect getBounds(const Vector2f& mCenter) const noexcept
+        {
+            return FloatRect{mCenter.x - radius, mCenter.y - radius,
+                             radius * 2.f, radius * 2.f};
+        }
+    };
+
+    struct CRectangle : Component
+    {
+        Vector2f size;
+        Color color;
+
+        CRectangle(const Vec2& mHalfSize, sf::Color mColor)
+                : size{toVector2f(mHalfSize) * 2.f}, color{mColor}
+        {
+        }
+
+        FloatRect getBounds(const Vector2f& mCenter) const noexcept
+        {
+            return FloatRect{mCenter - size / 2.f, size};
+        }
+    };
+
+    // Paddle commands for one simulation step.
+    struct InputState
+    {
+        bool left{false}, right{false};
+    };
+
+    // Set each step from the game's InputSource.
+    struct CPaddleControl : Component
+    {
+        InputState input;
+    };
+
+    struct SPaddleControl : System<CPaddleControl, CPhysics>
+    {
+        // CPhysics bounds are derived from the entity's CPosition.
+        using Reads = TypeList<CPaddleControl, CPosition>;
+        using Writes = TypeList<CPhysics>;
+
+        void operator()(CPaddleControl& cPaddleControl, CPhysics& cPhysics,
+                        Real, Real)
+        {
+            if(cPaddleControl.input.left && cPhysics.left() > 0)
+                cPhysics.velocity.x = -paddleVelocity;
+            else if(cPaddleControl.input.right &&
+                    cPhysics.right() < windowWidth)
+                cPhysics.velocity.x = paddleVelocity;
+            else
+                cPhysics.velocity.x = 0;
+        }
+    };
+
+    struct SPhysics : System<CPhysics, CPosition>
+    {
+        using Reads = TypeList<CPhysics, CPosition>;
+        using Writes = TypeList<CPhysics, CPosition>;
+
+        void operator()(CPhysics& cPhysics, CPosition& cPosition,
+                        Real mFT, Real mFieldHeight)
+        {
+            if(cPhysics.continuous) return;
+
+            bool atRest{cPhysics.velocity == Vec2{}};
+            if(cPhysics.sleeping && atRest) return;
+            cPhysics.sleeping = atRest;
+
+            cPosition.position += cPhysics.velocity * mFT;
+
+            if(cPhysics.onOutOfBounds == nullptr) return;
+
+            if(cPhysics.left() < 0)
+                cPhysics.onOutOfBounds(cPhysics, Vec2{1.f, 0.f});
+            else if(cPhysics.right() > windowWidth)
+                cPhysics.onOutOfBounds(cPhysics, Vec2{-1.f, 0.f});
+
+            if(cPhysics.top() < 0)
+                cPhysics.onOutOfBounds(cPhysics, Vec2{0.f, 1.f});
+            else if(cPhysics.bottom() > mFieldHeight)
+                cPhysics.onOutOfBounds(cPhysics, Vec2{0.f, -1.f});
+        }
+    };
+
+    // Records every moving body's position before a simulation step
+    // changes it. Static bodies are placed with `previous` equal to
+    // `position` and are not visited.
+    struct SPositionHistory : System<CPosition, CPhysics>
+    {
+        using Reads = TypeList<CPhysics>;
+        using Writes = TypeList<CPosition>;
+
+        void operator()(CPosition& cPosition, CPhysics&, Real)
+        {
+            cPosition.previous = cPosition.position;
+        }
+    };
+
+    // Collects every shape of a frame as triangles in one vertex array, so
+    // the frame is submitted with a single draw call. The array keeps its
+    // storage between frames.
+    class BatchRenderer
+    {
+    private:
+        static constexpr std::size_t circleSegments{24};
+
+        VertexArray vertices{Triangles};
+        std::array<Vector2f, circleSegments + 1> unitCircle;
+
+    public:
+        BatchRenderer()
+        {
+            for(std::size_t i{0}; i <= circleSegments; ++i)
+            {
+                float angle{i * 2.f * 3.14159265f / circleSegments};
+                unitCircle[i] = Vector2f{std::cos(angle), std::sin(angle)};
+            }
+        }
+
+        void clear() { vertices.clear(); }
+        bool isEmpty() const { return vertices.getVertexCount() == 0; }
+
+        // Replaces the batch with `mFrom` moved `mAlpha` of the way to
+        // `mTo`. Both must hold the same shapes, tessellated alike.
+        void interpolate(const BatchRenderer& mFrom, const BatchRenderer& mTo,
+                         float mAlpha)
+        {
+            auto count(mTo.vertices.getVertexCount());
+            assert(mFrom.vertices.getVertexCount() == count);
+
+            vertices.resize(count);
+            for(std::size_t i{0}; i < count; ++i)
+            {
+                const auto& from(mFrom.vertices[i]);
+                const auto& to(mTo.vertices[i]);
+                vertices[i] = Vertex{
+                        from.position + (to.position - from.position) * mAlpha,
+                        to.color};
+            }
+        }
+
+        void addRectangle(const Vector2f& mCenter, const Vector2f& mSize,
+                          const Color& mColor)
+        {
+            Vector2f topLeft{mCenter - mSize / 2.f};
+            Vector2f bottomRight{mCenter + mSize / 2.f};
+            Vector2f topRight{bottomRight.x, topLeft.y};
+            Vector2f bottomLeft{topLeft.x, bottomRight.y};
+
+            for(const auto& p : {topLeft, topRight, bottomRight, topLeft,
+                                 bottomRight, bottomLeft})
+                vertices.append(Vertex{p, mColor});
+        }
+
+        // A fan of triangles around the center.
+        void addCircle(const Vector2f& mCenter, float mRadius,
+                       const Color& mColor)
+        {
+            for(std::size_t i{0}; i < circleSegments; ++i)
+            {
+                vertices.append(Vertex{mCenter, mColor});
+                vertices.append(
+                        Vertex{mCenter + unitCircle[i] * mRadius, mColor});
+                vertices.append(
+                        Vertex{mCenter + unitCircle[i + 1] * mRadius, mColor});
+            }
+        }
+
+        void add(const CCircle& cCircle, const Vector2f& mCenter)
+        {
+            addCircle(mCenter, cCircle.radius, cCircle.color);
+        }
+
+        void add(const CRectangle& cRectangle, const Vector2f& mCenter)
+        {
+            addRectangle(mCenter, cRectangle.size, cRectangle.color);
+        }
+
+        void draw(RenderTarget& mTarget,
+                  const RenderStates& mStates = RenderStates::Default) const
+        {
+            mTarget.draw(vertices, mStates);
+        }
+    };
+
+    // A frame's shapes at both ends of the step it falls in, so a thread
+    // without access to the world can interpolate between them.
+    struct MotionBatch
+    {
+        BatchRenderer from, to;
+
+        void clear()
+        {
+            from.clear();
+            to.clear();
+        }
+
+        template <typename TShape>
+        void add(const TShape& cShape, const Vector2f& mFrom,
+                 const Vector2f& mTo)
+        {
+            from.add(cShape, mFrom);
+            to.add(cShape, mTo);
+        }
+
+        void addRectangle(const Vector2f& mCenter, const Vector2f& mSize,
+                          const Color& mColor)
+        {
+            from.addRectangle(mCenter, mSize, mColor);
+            to.addRectangle(mCenter, mSize, mColor);
+        }
+    };
+
+    // Batches a moving body's shape `mAlpha` of the way from its previous
+    // simulated position to the current one. Shapes entirely outside
+    // `mVisible` are skipped before being tessellated. Static bricks have
+    // no CPhysics; they are batched from a broadphase query instead.
+    template <typename TShape>
+    struct SShapeBatch : System<TShape, CPosition, CPhysics>
+    {
+        void operator()(TShape& cShape, CPosition& cPosition, CPhysics&,
+                        BatchRenderer& mBatch, float mAlpha,
+                        const FloatRect& mVisible)
+        {
+            auto previous(toVector2f(cPosition.previous));
+            auto center(previous +
+                        (toVector2f(cPosition.position) - previous) * mAlpha);
+
+            if(mVisible.intersects(cShape.getBounds(center)))
+                mBatch.add(cShape, center);
+        }
+
+        // Batches both ends of the step, for interpolating later.
+        void operator()(TShape& cShape, CPosition& cPosition, CPhysics&,
+                        MotionBatch& mBatch, const FloatRect& mVisible)
+        {
+            auto from(toVector2f(cPosition.previous));
+            auto to(toVector2f(cPosition.position));
+
+            if(mVisible.intersects(cShape.getBounds(from)) ||
+               mVisible.intersects(cShape.getBounds(to)))
+                mBatch.add(cShape, from, to);
+        }
+    };
+
+    using HistorySystems = SystemSchedule<SPositionHistory>;
+    using UpdateSystems = SystemSchedule<SPaddleControl, SPhysics>;
+
+    // Run once per rendered frame, on the thread that owns the window.
+    using RenderSystems =
+            SystemList<SShapeBatch<CRectangle>, SShapeBatch<CCircle>>;
+
+    // Axis-aligned box exposing the same bounds interface as CPhysics.
+    struct AABB
+    {
+        Vec2 center, halfSize;
+
+        Real x() const noexcept { return center.x; }
+        Real y() const noexcept { return center.y; }
+        Real left() const noexcept { return x() - halfSize.x; }
+        Real right() const noexcept { return x() + halfSize.x; }
+        Real top() const noexcept { return y() - halfSize.y; }
+        Real bottom() const noexcept { return y() + halfSize.y; }
+    };
+
+    template <class T1, class T2>
+    bool isIntersecting(T1& mA, T2& mB) noexcept
+    {
+        return mA.right() >= mB.left() && mA.left() <= mB.right() &&
+               mA.bottom() >= mB.top() && mA.top() <= mB.bottom();
+    }
+
+    void resolvePaddleBall(const CPhysics& cpPaddle, CPhysics& cpBall) noexcept
+    {
+        cpBall.velocity.y = -ballVelocity;
+        if(cpBall.x() < cpPaddle.x())
+            cpBall.velocity.x = -ballVelocity;
+        else
+            cpBall.velocity.x = ballVelocity;
+    }
+
+    void testCollisionPaddleBall(Entity& mPaddle, Entity& mBall) noexcept
+    {
+        auto& cpPaddle(mPaddle.getComponent<CPhysics>());
+        auto& cpBall(mBall.getComponent<CPhysics>());
+
+        if(isIntersecting(cpPaddle, cpBall))
+            resolvePaddleBall(cpPaddle, cpBall);
+    }
+
+    // Points the velocity away from a surface with normal `mNormal`,
+    // keeping its magnitude.
+    void reflect(CPhysics& cPhysics, const Vec2& mNormal) noexcept
+    {
+        if(mNormal.x != 0.f)
+            cPhysics.velocity.x = absolute(cPhysics.velocity.x) * mNormal.x;
+
+        if(mNormal.y != 0.f)
+            cPhysics.velocity.y = absolute(cPhysics.velocity.y) * mNormal.y;
+    }
+
+    struct SweepHit
+    {
+        // Fraction of the swept displacement at which contact begins.
+        Real time;
+        Vec2 normal;
+    };
+
+    namespace Internal
+    {
+        // Entry and exit times of a point moving from `mP` by `mD` through
+        // the open interval (mMin, mMax).
+        inline bool sweepSlab(Real mP, Real mD, Real mMin, Real mMax,
+                              Real& mEntry, Real& mExit) noexcept
+        {
+            if(mD == 0.f)
+            {
+                mEntry = -maxReal;
+                mExit = maxReal;
+                return mP > mMin && mP < mMax;
+            }
+
+            Real t1{(mMin - mP) / mD}, t2{(mMax - mP) / mD};
+            mEntry = std::min(t1, t2);
+            mExit = std::max(t1, t2);
+            return true;
+        }
+    }
+
+    // Sweeps the box `mMoving` by `mDisplacement` against the static box
+    // `mTarget`, as a point against the target grown by the moving box's
+    // half size. Boxes that already overlap or that touch while
+    // separating are not reported.
+    template <class T1, class T2>
+    bool sweepAABB(const T1& mMoving, const Vec2& mDisplacement,
+                   const T2& mTarget, SweepHit& mHit) noexcept
+    {
+        Real entryX, exitX, entryY, exitY;
+
+        if(!Internal::sweepSlab(mMoving.x(), mDisplacement.x,
+                                mTarget.left() - mMoving.halfSize.x,
+                                mTarget.right() + mMoving.halfSize.x, entryX,
+                                exitX) ||
+           !Internal::sweepSlab(mMoving.y(), mDisplacement.y,
+                                mTarget.top() - mMoving.halfSize.y,
+                                mTarget.bottom() + mMoving.halfSize.y, entryY,
+                                exitY))
+            return false;
+
+        Real entry{std::max(entryX, entryY)}, exit{std::min(exitX, exitY)};
+        if(entry >= exit || entry < 0.f || entry > 1.f) return false;
+
+        mHit.time = entry;
+        if(entryX > entryY)
+            mHit.normal = Vec2{mDisplacement.x < 0.f ? 1.f : -1.f, 0.f};
+        else
+            mHit.normal = Vec2{0.f, mDisplacement.y < 0.f ? 1.f : -1.f};
+
+        return true;
+    }
+
+    // Bounds covering a box over its whole displacement.
+    template <class T>
+    AABB getSweptBounds(const T& mBox, const Vec2& mDisplacement) noexcept
+    {
+        return AABB{Vec2{mBox.x(), mBox.y()} + mDisplacement / Real{2.f},
+                    mBox.halfSize + Vec2{absolute(mDisplacement.x),
+                                         absolute(mDisplacement.y)} /
+                                            Real{2.f}};
+    }
+
+    // Box bounds stored as structure-of-arrays so that one query box can
+    // be tested against several of them per instruction.
+    struct BoundsSoA
+    {
+        std::vector<Real> left, right, top, bottom;
+
+        std::size_t size() const noexcept { return left.size(); }
+
+        template <typename TBounds>
+        void push(const TBounds& mBounds)
+        {
+            left.emplace_back(mBounds.left());
+            right.emplace_back(mBounds.right());
+            top.emplace_back(mBounds.top());
+            bottom.emplace_back(mBounds.bottom());
+        }
+
+        void swapAndPop(std::size_t mI) noexcept
+        {
+            left[mI] = left.back();
+            right[mI] = right.back();
+            top[mI] = top.back();
+            bottom[mI] = bottom.back();
+            left.pop_back();
+            right.pop_back();
+            top.pop_back();
+            bottom.pop_back();
+        }
+    };
+
+    // Bit `i` of the result is set when box `mBegin + i` overlaps `mQuery`,
+    // with the same inclusive test as `isIntersecting`. At most 32 boxes
+    // are tested per call; AVX tests 8 per step, SSE 4, and the remainder
+    // falls back to scalar code. AVX is used when building with
+    // ARKANOID_AVX2.
+    inline std::uint32_t overlapMask(const BoundsSoA& mBoxes,
+                                     std::size_t mBegin, std::size_t mCount,
+                                     const AABB& mQuery) noexcept
+    {
+        assert(mCount <= 32 && mBegin + mCount <= mBoxes.size());
+
+        const Real *l{mBoxes.left.data() + mBegin},
+                *r{mBoxes.right.data() + mBegin},
+                *t{mBoxes.top.data() + mBegin},
+                *b{mBoxes.bottom.data() + mBegin};
+        std::uint32_t mask{0};
+        std::size_t i{0};
+
+        // The vector paths compare floats; fixed-point builds use the
+        // scalar loop only.
+#if !defined(ARKANOID_FIXED_POINT) && defined(__AVX__)
+        {
+            auto qL(_mm256_set1_ps(mQuery.left()));
+            auto qR(_mm256_set1_ps(mQuery.right()));
+            auto qT(_mm256_set1_ps(mQuery.top()));
+            auto qB(_mm256_set1_ps(mQuery.bottom()));
+
+            for(; i + 8 <= mCount; i += 8)
+            {
+                auto hit(_mm256_and_ps(
+                        _mm256_and_ps(_mm256_cmp_ps(_mm256_loadu_ps(r + i),
+                                                    qL, _CMP_GE_OQ),
+                                      _mm256_cmp_ps(_mm256_loadu_ps(l + i),
+                                                    qR, _CMP_LE_OQ)),
+                        _mm256_and_ps(_mm256_cmp_ps(_mm256_loadu_ps(b + i),
+                                                    qT, _CMP_GE_OQ),
+                                      _mm256_cmp_ps(_mm256_loadu_ps(t + i),
+                                                    qB, _CMP_LE_OQ))));
+
+                mask |= static_cast<std::uint32_t>(_mm256_movemask_ps(hit))
+                        << i;
+            }
+        }
+#endif
+
+#if !defined(ARKANOID_FIXED_POINT) && \
+        (defined(__SSE2__) || defined(_M_X64))
+        {
+            auto qL(_mm_set1_ps(mQuery.left()));
+            auto qR(_mm_set1_ps(mQuery.right()));
+            auto qT(_mm_set1_ps(mQuery.top()));
+            auto qB(_mm_set1_ps(mQuery.bottom()));
+
+            for(; i + 4 <= mCount; i += 4)
+            {
+                auto hit(_mm_and_ps(
+                        _mm_and_ps(_mm_cmpge_ps(_mm_loadu_ps(r + i), qL),
+                                   _mm_cmple_ps(_mm_loadu_ps(l + i), qR)),
+                        _mm_and_ps(_mm_cmpge_ps(_mm_loadu_ps(b + i), qT),
+                                   _mm_cmple_ps(_mm_loadu_ps(t + i), qB))));
+
+                mask |= static_cast<std::uint32_t>(_mm_movemask_ps(hit))
+                        << i;
+            }
+        }
+#endif
+
+        for(; i < mCount; ++i)
+            if(r[i] >= mQuery.left() && l[i] <= mQuery.right() &&
+               b[i] >= mQuery.top() && t[i] <= mQuery.bottom())
+                mask |= std::uint32_t{1} << i;
+
+        return mask;
+    }
+
+    // Uniform-grid broadphase over the playfield for static bodies, such as
+    // bricks. Each body is stored in every cell its CStaticBody bounds
+    // overlap, next to a copy of those bounds taken on insertion.
+    // Queries test the stored bounds with `overlapMask` and return only
+    // overlapping bodies, possibly more than once.
+    class SpatialGrid
+    {
+    private:
+        struct Cell
+        {
+            std::vector<Entity> entities;
+            BoundsSoA bounds;
+        };
+
+        Real cellSize;
+        int columns, rows;
+        std::vector<Cell> cells;
+
+        int column(Real mX) const noexcept
+        {
+            return std::max(0, std::min(columns - 1,
+                                        floorToInt(mX / cellSize)));
+        }
+
+        int row(Real mY) const noexcept
+        {
+            return std::max(0, std::min(rows - 1,
+                                        floorToInt(mY / cellSize)));
+        }
+
+        template <typename TBounds, typename TF>
+        void forCells(const TBounds& mBounds, TF&& mFn)
+        {
+            auto lastColumn(column(mBounds.right()));
+            auto lastRow(row(mBounds.bottom()));
+
+            for(auto iY(row(mBounds.top())); iY <= lastRow; ++iY)
+                for(auto iX(column(mBounds.left())); iX <= lastColumn; ++iX)
+                    mFn(cells[iY * columns + iX]);
+        }
+
+        // A body spanning several cells is stored in each of them; it is
+        // reported only from the first one it shares with `mQuery`.
+        bool isFirstShared(const Cell& mCell, std::size_t mI,
+                           const AABB& mQuery) const noexcept
+        {
+            auto iX(column(std::max(mCell.bounds.left[mI], mQuery.left())));
+            auto iY(row(std::max(mCell.bounds.top[mI], mQuery.top())));
+            return &cells[iY * columns + iX] == &mCell;
+        }
+
+    public:
+        SpatialGrid(float mWidth, float mHeight, float mCellSize)
+                : cellSize{mCellSize},
+                  columns{static_cast<int>(std::ceil(mWidth / mCellSize))},
+                  rows{static_cast<int>(std::ceil(mHeight / mCellSize))},
+                  cells(columns * rows)
+        {
+        }
+
+        void clear()
+        {
+            for(auto& c : cells) c = Cell{};
+        }
+
+        void insert(const Entity& mEntity)
+        {
+            auto& cp(mEntity.getComponent<CStaticBody>());
+            AABB bounds{Vec2{cp.x(), cp.y()}, cp.halfSize};
+
+            forCells(bounds, [&mEntity, &bounds](Cell& mCell)
+                     {
+                         mCell.entities.emplace_back(mEntity);
+                         mCell.bounds.push(bounds);
+                     });
+        }
+
+        void remove(const Entity& mEntity)
+        {
+            auto& cp(mEntity.getComponent<CStaticBody>());
+            AABB bounds{Vec2{cp.x(), cp.y()}, cp.halfSize};
+            auto index(mEntity.getIndex());
+
+            forCells(bounds, [index](Cell& mCell)
+                     {
+                         auto& es(mCell.entities);
+                         for(auto i(0u); i < es.size(); ++i)
+                         {
+                             if(es[i].getIndex() != index) continue;
+
+                             es[i] = es.back();
+                             es.pop_back();
+                             mCell.bounds.swapAndPop(i);
+                             return;
+                         }
+                     });
+        }
+
+        // Calls `mFn(entity)` once for every body overlapping `mBounds`.
+        // Does not modify the grid, so several threads may query it at
+        // once.
+        template <typename TBounds, typename TF>
+        void forOverlapping(const TBounds& mBounds, TF&& mFn)
+        {
+            AABB bounds{Vec2{mBounds.x(), mBounds.y()}, mBounds.halfSize};
+
+            forCells(bounds, [this, &bounds, &mFn](Cell& mCell)
+                     {
+                         auto count(mCell.entities.size());
+                         for(std::size_t i{0}; i < count; i += 32)
+                         {
+                             auto mask(overlapMask(
+                                     mCell.bounds, i,
+                                     std::min<std::size_t>(32, count - i),
+                                     bounds));
+
+                             for(auto j(i); mask != 0; mask >>= 1, ++j)
+                                 if((mask & 1u) &&
+                                    isFirstShared(mCell, j, bounds))
+                                     mFn(mCell.entities[j]);
+                         }
+                     });
+        }
+    };
+
+    // Bricks of a grid-aligned level, stored as one occupancy bit and one
+    // byte of remaining hits per lattice cell instead of one entity each.
+    // The cell pitch is larger than a ball, so a ball overlaps at most
+    // four cells and collision cost does not depend on the brick count.
+    class BrickField
+    {
+    private:
+        Vec2 origin, pitch, brickHalfSize;
+        int columns, rows;
+        std::vector<std::uint64_t> occupancy;
+        std::vector<std::uint8_t> hits;
+        std::size_t remaining{0};
+
+        std::size_t cell(int mX, int mY) const noexcept
+        {
+            return static_cast<std::size_t>(mY * columns + mX);
+        }
+
+        int clampColumn(Real mX) const noexcept
+        {
+            auto c(floorToInt((mX - origin.x) / pitch.x));
+            return std::max(0, std::min(columns - 1, c));
+        }
+
+        int clampRow(Real mY) const noexcept
+        {
+            auto r(floorToInt((mY - origin.y) / pitch.y));
+            return std::max(0, std::min(rows - 1, r));
+        }
+
+    public:
+        // `mOrigin` is the top-left corner of cell (0, 0); bricks are
+        // centered in their cells.
+        BrickField(const Vec2& mOrigin, const Vec2& mPitch,
+                   const Vec2& mBrickHalfSize, int mColumns, int mRows)
+                : origin{mOrigin}, pitch{mPitch}, brickHalfSize{mBrickHalfSize},
+                  columns{mColumns}, rows{mRows},
+                  occupancy((mColumns * mRows + 63) / 64),
+                  hits(mColumns * mRows)
+        {
+        }
+
+        int getColumns() const noexcept { return columns; }
+        int getRows() const noexcept { return rows; }
+        std::size_t getRemaining() const noexcept { return remaining; }
+
+        void fill(std::uint8_t mHits)
+        {
+            std::fill(std::begin(occupancy), std::end(occupancy), 0);
+            for(auto i(0u); i < hits.size(); ++i)
+                occupancy[i / 64] |= std::uint64_t{1} << (i % 64);
+
+            std::fill(std::begin(hits), std::end(hits), mHits);
+            remaining = hits.size();
+        }
+
+        bool isOccupied(int mX, int mY) const noexcept
+        {
+            auto i(cell(mX, mY));
+            return (occupancy[i / 64] >> (i % 64)) & 1u;
+        }
+
+        AABB getBrick(int mX, int mY) const noexcept
+        {
+            return AABB{origin + Vec2{(mX + .5f) * pitch.x,
+                                      (mY + .5f) * pitch.y},
+                        brickHalfSize};
+        }
+
+        // Takes one hit off the brick; returns true when it is destroyed.
+        bool hit(int mX, int mY) noexcept
+        {
+            auto i(cell(mX, mY));
+            if(--hits[i] > 0) return false;
+
+            occupancy[i / 64] &= ~(std::uint64_t{1} << (i % 64));
+            --remaining;
+            return true;
+        }
+
+        // Calls `mFn(x, y)` for every occupied cell overlapping `mBounds`.
+        template <typename TBounds, typename TF>
+        void forOverlapping(const TBounds& mBounds, TF&& mFn) const
+        {
+            // Clamping would still yield cell (0, 0) of an empty field.
+            if(rows == 0 || columns == 0) return;
+
+            auto lastColumn(clampColumn(mBounds.right()));
+            auto lastRow(clampRow(mBounds.bottom()));
+
+            for(auto iY(clampRow(mBounds.top())); iY <= lastRow; ++iY)
+                for(auto iX(clampColumn(mBounds.left())); iX <= lastColumn;
+                    ++iX)
+                    if(isOccupied(iX, iY)) mFn(iX, iY);
+        }
+
+        Vec2 getPitch() const noexcept { return pitch; }
+
+        // One bit per cell, row-major, set while the cell holds a brick.
+        const std::vector<std::uint64_t>& getOccupancy() const noexcept
+        {
+            return occupancy;
+        }
+    };
+
+    // Sort-and-sweep broadphase for moving bodies. Bodies are kept sorted
+    // by the left edge of their bounds across updates; they move little
+    // per step, so an insertion sort restores the order in near-linear
+    // time. Pairs are found by sweeping along x and testing y.
+    class SweepAndPrune
+    {
+    private:
+        struct Interval
+        {
+            Entity entity;
+            Real left, right, top, bottom;
+        };
+
+        Group group;
+        std::vector<Interval> intervals;
+        std::vector<bool> tracked;
+
+    public:
+        // Tracks the bodies in group `mGroup`.
+        SweepAndPrune(Group mGroup) : group{mGroup} {}
+
+        // Drops bodies that died or left the group, adds new ones from
+        // `mBodies` and re-sorts with the current bounds.
+        void update(const std::vector<Entity>& mBodies)
+        {
+            for(const auto& e : mBodies)
+                if(tracked.size() <= e.getIndex())
+                    tracked.resize(e.getIndex() + 1, false);
+
+            intervals.erase(
+                    std::remove_if(std::begin(intervals), std::end(intervals),
+                                   [this](const Interval& mI)
+                                   {
+                                       if(mI.entity.isAlive() &&
+                                          mI.entity.hasGroup(group))
+                                           return false;
+
+                                       tracked[mI.entity.getIndex()] = false;
+                                       return true;
+                                   }),
+                    std::end(intervals));
+
+            for(const auto& e : mBodies)
+            {
+                if(!e.isAlive() || tracked[e.getIndex()]) continue;
+
+                tracked[e.getIndex()] = true;
+                intervals.emplace_back(Interval{e, 0.f, 0.f, 0.f, 0.f});
+            }
+
+            for(auto& i : intervals)
+            {
+                auto& cPhysics(i.entity.getComponent<CPhysics>());
+                i.left = cPhysics.left();
+                i.right = cPhysics.right();
+                i.top = cPhysics.top();
+                i.bottom = cPhysics.bottom();
+            }
+
+            for(std::size_t i{1}; i < intervals.size(); ++i)
+            {
+                auto interval(intervals[i]);
+                auto j(i);
+
+                for(; j > 0 && intervals[j - 1].left > interval.left; --j)
+                    intervals[j] = intervals[j - 1];
+
+                intervals[j] = interval;
+            }
+        }
+
+        // Calls `mFn(a, b)` for every pair of bodies whose bounds overlap,
+        // as of the last update.
+        template <typename TF>
+        void forEachPair(TF&& mFn)
+        {
+            for(std::size_t i{0}; i < intervals.size(); ++i)
+            {
+                auto& a(intervals[i]);
+
+                for(auto j(i + 1);
+                    j < intervals.size() && intervals[j].left <= a.right; ++j)
+                {
+                    auto& b(intervals[j]);
+                    if(a.bottom >= b.top && a.top <= b.bottom)
+                        mFn(a.entity, b.entity);
+                }
+            }
+        }
+    };
+
+    // Elastic collision between two balls, with masses proportional to
+    // their areas. Overlapping balls are also pushed apart through
+    // `mPush(ball, offset)`, which may stop a ball short of an obstacle.
+    template <typename TF>
+    void collideBallBall(Entity& mA, Entity& mB, TF&& mPush)
+    {
+        auto& cpA(mA.getComponent<CPhysics>());
+        auto& cpB(mB.getComponent<CPhysics>());
+
+        Real rA{cpA.halfSize.x}, rB{cpB.halfSize.x};
+        Vec2 delta{mB.getComponent<CPosition>().position -
+                   mA.getComponent<CPosition>().position};
+        Real distance{squareRoot(delta.x * delta.x + delta.y * delta.y)};
+        if(distance >= rA + rB) return;
+
+        // Balls spawned on the same spot would otherwise never separate.
+        Vec2 normal{distance == 0.f ? Vec2{1.f, 0.f} : delta / distance};
+        Real massA{rA * rA}, massB{rB * rB};
+        Real penetration{rA + rB - distance};
+
+        mPush(mA, normal * (-penetration * massB / (massA + massB)));
+        mPush(mB, normal * (penetration * massA / (massA + massB)));
+
+        Vec2 relative{cpB.velocity - cpA.velocity};
+        Real approach{relative.x * normal.x + relative.y * normal.y};
+        if(approach >= 0.f) return;
+
+        Real impulse{-2.f * approach / (1.f / massA + 1.f / massB)};
+        cpA.velocity -= normal * (impulse / massA);
+        cpB.velocity += normal * (impulse / massB);
+    }
+
+    // Earliest surface a ball reaches during a sweep. Contacts are
+    // generated for every ball before any of them is resolved.
+    struct Contact
+    {
+        enum class Target
+        {
+            None,
+            Wall,
+            Paddle,
+            Brick,
+            FieldBrick
+        };
+
+        Target target{Target::None};
+        Entity other;
+        int cellX{0}, cellY{0};
+        SweepHit hit{1.f, Vec2{}};
+    };
+
+    // The brick field pre-rendered into a texture that is drawn as one
+    // sprite. Only the cells whose occupancy changed since the previous
+    // update are cleared and drawn again; finding them costs one word
+    // comparison per 64 cells.
+    class BrickLayer
+    {
+    private:
+        RenderTexture texture;
+        Sprite sprite;
+        BatchRenderer bricks, clears;
+        std::vector<std::uint64_t> drawn;
+
+        void batchCell(const BrickField& mField, int mX, int mY)
+        {
+            auto brick(mField.getBrick(mX, mY));
+            clears.addRectangle(toVector2f(brick.center),
+                                toVector2f(mField.getPitch()),
+                                Color::Transparent);
+
+            if(mField.isOccupied(mX, mY))
+                bricks.addRectangle(toVector2f(brick.center),
+                                    toVector2f(brick.halfSize) * 2.f,
+                                    Color::Yellow);
+        }
+
+        void flush()
+        {
+            // Clearing overwrites the cell's pixels instead of blending.
+            clears.draw(texture, RenderStates{BlendNone});
+            bricks.draw(texture);
+            texture.display();
+
+            clears.clear();
+            bricks.clear();
+        }
+
+    public:
+        BrickLayer(unsigned int mWidth, unsigned int mHeight)
+        {
+            texture.create(mWidth, mHeight);
+            texture.clear(Color::Transparent);
+            sprite.setTexture(texture.getTexture());
+
+            // Updates may run on the render thread, which cannot activate
+            // a context still active on this one.
+            texture.setActive(false);
+        }
+
+        // Only reads `mField`, which may be a copy taken on another thread.
+        void update(const BrickField& mField)
+        {
+            const auto& occupancy(mField.getOccupancy());
+            drawn.resize(occupancy.size());
+
+            for(std::size_t i{0}; i < occupancy.size(); ++i)
+            {
+                auto changed(drawn[i] ^ occupancy[i]);
+                drawn[i] = occupancy[i];
+
+                for(auto bit(i * 64); changed != 0; changed >>= 1, ++bit)
+                    if(changed & 1u)
+                        batchCell(mField,
+                                  static_cast<int>(bit % mField.getColumns()),
+                                  static_cast<int>(bit / mField.getColumns()));
+            }
+
+            if(!clears.isEmpty()) flush();
+        }
+
+        void draw(RenderTarget& mTarget) { mTarget.draw(sprite); }
+    };
+
+    // Center of the brick in lattice cell (mX, mY).
+    inline Vec2 getBrickPosition(int mX, int mY) noexcept
+    {
+        return Vec2{(mX + 1) * (blockWidth + 3) + 22,
+                    (mY + 2) * (blockHeight + 3)};
+    }
+
+    enum ArkanoidGroup : std::size_t
+    {
+        GPaddle,
+        GBrick,
+        GBall
+    };
+
+    // Factories accept either an EntityContainer, to spawn immediately, or a
+    // CommandBuffer, to spawn at its next flush().
+    struct BallFactory
+    {
+        template <typename TTarget>
+        static void create(TTarget& target, Real mFieldHeight)
+        {
+            auto entity(target.createEntity());
+
+            CPhysics cPhysics{Vec2{ballRadius, ballRadius}};
+            cPhysics.velocity = Vec2{-ballVelocity, -ballVelocity};
+            cPhysics.onOutOfBounds = reflect;
+            cPhysics.continuous = true;
+
+            entity.template addComponent<CPosition>(
+                    Vec2{windowWidth / 2.f, mFieldHeight - windowHeight / 2.f});
+            entity.template addComponent<CPhysics>(cPhysics);
+            entity.template addComponent<CCircle>(ballRadius);
+
+            entity.addGroup(ArkanoidGroup::GBall);
+        }
+    };
+
+    struct BrickFactory
+    {
+        // Bricks only differ by position: build the archetype once and
+        // instantiate it with EntityContainer::instantiate().
+        static void initPrefab(Prefab& mPrefab)
+        {
+            Vec2 halfSize{blockWidth / 2.f, blockHeight / 2.f};
+
+            mPrefab.addComponent<CPosition>();
+            mPrefab.addComponent<CStaticBody>(halfSize);
+            mPrefab.addComponent<CRectangle>(halfSize, sf::Color::Yellow);
+
+            mPrefab.addGroup(ArkanoidGroup::GBrick);
+        }
+    };
+
+    struct PaddleFactory
+    {
+        template <typename TTarget>
+        static void create(TTarget& target, Real mFieldHeight)
+        {
+            Vec2 halfSize{paddleWidth / 2.f, paddleHeight / 2.f};
+            auto entity(target.createEntity());
+
+            entity.template addComponent<CPosition>(
+                    Vec2{windowWidth / 2.f, mFieldHeight - 60.f});
+            entity.template addComponent<CPhysics>(halfSize);
+            entity.template addComponent<CRectangle>(halfSize, sf::Color::Red);
+            entity.template addComponent<CPaddleControl>();
+
+            entity.addGroup(ArkanoidGroup::GPaddle);
+        }
+    };
+
+    // Decides the player's commands for each simulation step. Sources may
+    // look at the world but must not change it.
+    class InputSource
+    {
+    public:
+        virtual InputState poll(EntityContainer& mContainer) = 0;
+        virtual ~InputSource() {}
+    };
+
+    class KeyboardInput : public InputSource
+    {
+    public:
+        InputState poll(EntityContainer&) override
+        {
+            return InputState{Keyboard::isKeyPressed(Keyboard::Key::Left),
+                              Keyboard::isKeyPressed(Keyboard::Key::Right)};
+        }
+    };
+
+    // Keeps the paddle under the first ball, for unattended runs.
+    class AutoPilotInput : public InputSource
+    {
+    public:
+        InputState poll(EntityContainer& mContainer) override
+        {
+            auto& balls(mContainer.getEntitiesByGroup(GBall));
+            auto& paddles(mContainer.getEntitiesByGroup(GPaddle));
+            if(balls.empty() || paddles.empty()) return InputState{};
+
+            auto ballX(balls.front().getComponent<CPosition>().x());
+            auto paddleX(paddles.front().getComponent<CPosition>().x());
+            const Real deadZone{paddleWidth / 4.f};
+
+            return InputState{ballX < paddleX - deadZone,
+                              ballX > paddleX + deadZone};
+        }
+    };
+
+    // Real time that passed during each frame, in milliseconds.
+    class TimeSource
+    {
+    public:
+        virtual FrameTime tick() = 0;
+        virtual ~TimeSource() {}
+    };
+
+    class ClockTimeSource : public TimeSource
+    {
+    private:
+        chrono::high_resolution_clock::time_point last{
+                chrono::high_resolution_clock::now()};
+
+    public:
+        FrameTime tick() override
+        {
+            auto now(chrono::high_resolution_clock::now());
+            FrameTime ft{chrono::duration_cast<chrono::duration<float, milli>>(
+                                 now - last)
+                                 .count()};
+            last = now;
+            return ft;
+        }
+    };
+
+    // Reports a fixed time per frame however long frames really take, so
+    // the simulation runs as fast as the machine allows.
+    class FastForwardTimeSource : public TimeSource
+    {
+    private:
+        FrameTime step;
+
+    public:
+        FastForwardTimeSource(FrameTime mStep) : step{mStep} {}
+
+        FrameTime tick() override { return step; }
+    };
+
+    struct GameConfig
+    {
+        // Store the brick lattice in a BrickField rather than as entities.
+        bool gridAlignedBricks{true};
+
+        // Simulation steps per second, independent of the display rate.
+        // Balls move with swept collision tests, so steps need not be
+        // short enough to keep them from tunneling through a brick.
+        float tickRate{120.f};
+
+        // Most steps one frame may run to catch up with real time. Beyond
+        // it the remaining backlog is dropped and the game slows down.
+        int maxStepsPerFrame{8};
+
+        // Draw on a dedicated thread from snapshots published by the
+        // simulation, so a slow display() does not delay simulating.
+        bool renderThread{false};
+
+        // Run without a window or graphics context: the paddle follows the
+        // ball and every frame advances one step without waiting.
+        bool headless{false};
+
+        // Stop after this many steps; zero runs until the window closes.
+        // Headless runs have no window and need a nonzero count.
+        std::uint64_t maxSteps{0};
+
+        // Rows in the brick lattice. Each row past the default makes the
+        // field taller, and the camera scrolls to follow the ball.
+        int brickRows{countBlocksY};
+
+        float getFieldHeight() const noexcept
+        {
+            return windowHeight +
+                   std::max(0, brickRows - countBlocksY) * (blockHeight + 3);
+        }
+    };
+
+    // Everything drawn until the next snapshot, copied out of the
+    // simulation. The renderer interpolates shapes and camera itself, as
+    // `alpha` plus the time since `published` advances through the step.
+    struct RenderSnapshot
+    {
+        MotionBatch shapes;
+        BrickField bricks;
+        Vector2f cameraFrom, cameraTo;
+        float alpha{0.f};
+        chrono::high_resolution_clock::time_point published;
+    };
+
+    // Counters for monitoring how well the simulation keeps up.
+    struct SimulationStats
+    {
+        std::uint64_t steps{0};
+
+        // Frames that hit GameConfig::maxStepsPerFrame, and the real time
+        // they dropped from the simulation.
+        std::uint64_t overrunFrames{0};
+        FrameTime droppedTime{0.f};
+    };
+
+    inline std::ostream& operator<<(std::ostream& mStream,
+                                    const SimulationStats& mStats)
+    {
+        return mStream << mStats.steps << " steps, " << mStats.overrunFrames
+                       << " overrun frames, " << mStats.droppedTime
+                       << " ms dropped";
+    }
+
+    struct Game
+    {
+        GameConfig config;
+        Real fieldHeight{config.getFieldHeight()};
+
+        // Null when headless, along with everything else needing a
+        // graphics context.
+        std::unique_ptr<RenderWindow> window;
+        std::unique_ptr<BrickLayer> brickLayer;
+        std::unique_ptr<InputSource> inputSource;
+        std::unique_ptr<TimeSource> timeSource;
+        FrameTime ftSlice, lastFt{0.f}, currentSlice{0.f};
+        Real ftStep;
+        SimulationStats stats;
+        std::atomic<bool> running{false};
+        EntityContainer container;
+        CommandBuffer commands;
+        ThreadPool threadPool;
+        Prefab brickPrefab;
+        // Only free-form bricks are entities; lattice levels leave it null.
+        std::unique_ptr<SpatialGrid> brickGrid;
+        std::vector<Contact> contacts;
+        std::vector<Real> ballTimes;
+        SweepAndPrune ballPairs{GBall};
+        BrickField brickField{
+                getBrickPosition(0, 0) -
+                        Vec2{blockWidth + 3, blockHeight + 3} / Real{2.f},
+                Vec2{blockWidth + 3, blockHeight + 3},
+                Vec2{blockWidth / 2.f, blockHeight / 2.f}, countBlocksX,
+                config.brickRows};
+        BatchRenderer batch;
+        sf::View camera{FloatRect{0.f, 0.f, windowWidth, windowHeight}};
+        TripleBuffer<RenderSnapshot> snapshots{
+                RenderSnapshot{MotionBatch{}, brickField, camera.getCenter(),
+                               camera.getCenter(), 0.f,
+                               chrono::high_resolution_clock::now()}};
+
+        Game(const GameConfig& mConfig = GameConfig{})
+                : config(mConfig), ftSlice{1000.f / mConfig.tickRate},
+                  ftStep{ftSlice}
+        {
+            assert(std::isfinite(ftSlice) && ftSlice > 0.f);
+            assert(config.brickRows >= 0 && config.brickRows <= maxBrickRows);
+
+            if(config.headless)
+            {
+                inputSource = std::make_unique<AutoPilotInput>();
+                timeSource = std::make_unique<FastForwardTimeSource>(ftSlice);
+            }
+            else
+            {
+                window = std::make_unique<RenderWindow>(
+                        VideoMode(windowWidth, windowHeight), "Arkanoid");
+                window->setFramerateLimit(240);
+
+                // A texture holding a whole scrolling field would grow
+                // with the level; those are batched per frame instead.
+                if(config.getFieldHeight() <= windowHeight)
+                    brickLayer = std::make_unique<BrickLayer>(windowWidth,
+                                                              windowHeight);
+                inputSource = std::make_unique<KeyboardInput>();
+                timeSource = std::make_unique<ClockTimeSource>();
+            }
+
+            if(!config.gridAlignedBricks)
+                brickGrid = std::make_unique<SpatialGrid>(
+                        windowWidth, config.getFieldHeight(), brickCellSize);
+
+            BrickFactory::initPrefab(brickPrefab);
+            loadLevel();
+        }
+
+        void loadLevel()
+        {
+            container.clear();
+            container.reserve(
+                    2 + (config.gridAlignedBricks
+                                 ? 0
+                                 : countBlocksX * config.brickRows));
+
+            PaddleFactory::create(commands, fieldHeight);
+            BallFactory::create(commands, fieldHeight);
+            commands.flush(container);
+
+            if(config.gridAlignedBricks)
+            {
+                brickField.fill(1);
+                return;
+            }
+
+            brickGrid->clear();
+
+            // Bricks are placed after the prefab copies are built; set both
+            // positions so the first frame does not interpolate from the
+            // prototype's.
+            auto rows(config.brickRows);
+            container.instantiate(
+                    brickPrefab, countBlocksX * rows,
+                    [rows](Entity& mBrick, std::size_t mI)
+                    {
+                        int iX(mI / rows), iY(mI % rows);
+                        auto& cPosition(mBrick.getComponent<CPosition>());
+                        cPosition.position = cPosition.previous =
+                                getBrickPosition(iX, iY);
+                    });
+
+            for(auto& b : container.getEntitiesByGroup(GBrick))
+                brickGrid->insert(b);
+        }
+
+        void run()
+        {
+            running = true;
+
+            // Events keep being polled here, on the thread that created
+            // the window; only its drawing context moves to the renderer.
+            std::thread renderer;
+            if(config.renderThread && window != nullptr)
+            {
+                window->setActive(false);
+                renderer = std::thread{[this]
+                                       {
+                                           renderLoop();
+                                       }};
+            }
+
+            while(running)
+            {
+                if(window != nullptr) inputPhase();
+                updatePhase();
+
+                if(window == nullptr)
+                {
+                    // Nothing to show.
+                }
+                else if(config.renderThread)
+                {
+                    publishSnapshot();
+
+                    // Nothing to do until the next step is due.
+                    this_thread::sleep_for(chrono::duration<float, milli>(
+                            ftSlice - currentSlice));
+                }
+                else
+                    drawPhase();
+
+                lastFt = timeSource->tick();
+
+                if(config.maxSteps != 0 && stats.steps >= config.maxSteps)
+                    running = false;
+            }
+
+            if(renderer.joinable()) renderer.join();
+            if(window != nullptr) window->close();
+        }
+
+        void inputPhase()
+        {
+            Event event;
+            while(window->pollEvent(event))
+            {
+                if(event.type == Event::Closed)
+                {
+                    running = false;
+                    break;
+                }
+            }
+
+            if(Keyboard::isKeyPressed(Keyboard::Key::Escape)) running = false;
+        }
+
+        void updatePhase()
         {
             currentSlice += lastFt;
-            for(; currentSlice >= ftSlice; currentSlice -= ftSlice)
+
+            // After a stall, running every step owed would make this frame
+            // slow as well, and the one after it, and so on.
+            for(auto steps(0); currentSlice >= ftSlice &&
+                               steps < config.maxStepsPerFrame;
+                currentSlice -= ftSlice, ++steps)
             {
+                // Sync point: structural changes recorded during the last
+                // step are applied before anything iterates the container.
+                commands.flush(container);
                 container.refresh();
-                container.update(ftStep);
 
-                auto& paddles(container.getEntitiesByGroup(GPaddle));
-                auto& bricks(container.getEntitiesByGroup(GBrick));
+                auto input(inputSource->poll(container));
+                container.each<CPaddleControl>(
+                        [&input](CPaddleControl& mControl)
+                        {
+                            mControl.input = input;
+                        });
+
+                HistorySystems::run(container, threadPool, ftStep);
+
                 auto& balls(container.getEntitiesByGroup(GBall));
+                moveBalls(balls, ftStep);
+
+                auto push([this](Entity& mBall, const Vec2& mOffset)
+                          {
+                              pushBall(mBall, mOffset);
+                          });
+                ballPairs.update(balls);
+                ballPairs.forEachPair([&push](Entity& mA, Entity& mB)
+                                      {
+                                          collideBallBall(mA, mB, push);
+                                      });
+
+                UpdateSystems::run(container, threadPool, ftStep, fieldHeight);
+                ++stats.steps;
+            }
 
-                for(auto& b : balls)
-                {
-                    for(auto& p : paddles) testCollisionPaddleBall(*p, *b);
+            if(currentSlice < ftSlice) return;
 
-                    for(auto& br : bricks) testCollisionBrickBall(*br, *b);
-                }
+            // Keep the partial step so interpolation stays continuous.
+            auto kept(std::fmod(currentSlice, ftSlice));
+            ++stats.overrunFrames;
+            stats.droppedTime += currentSlice - kept;
+            currentSlice = kept;
+        }
+
+        // Moves the balls through the step, stopping each at every
+        // surface it reaches to bounce off it, so they cannot tunnel
+        // however far they travel per step. Each round generates the next
+        // contact of every ball in parallel, then resolves the contacts in
+        // ball order so the outcome does not depend on the threads. Time
+        // left after `maxSweeps` rounds is lost.
+        void moveBalls(std::vector<Entity>& mBalls, Real mFT)
+        {
+            constexpr int maxSweeps{8};
+            constexpr std::size_t chunkSize{256};
+
+            // Paddles move after the balls and may end up overlapping one.
+            for(auto& b : mBalls)
+                for(auto& p : container.getEntitiesByGroup(GPaddle))
+                    testCollisionPaddleBall(p, b);
+
+            ballTimes.assign(mBalls.size(), mFT);
+            contacts.resize(mBalls.size());
+
+            auto generate([this, &mBalls](std::size_t mBegin, std::size_t mEnd)
+                          {
+                              for(auto i(mBegin); i < mEnd; ++i)
+                                  contacts[i] = findContact(mBalls[i],
+                                                            ballTimes[i]);
+                          });
+
+            for(auto i(0); i < maxSweeps; ++i)
+            {
+                threadPool.parallelFor(mBalls.size(), chunkSize, generate);
+
+                bool moving{false};
+                for(std::size_t j{0}; j < mBalls.size(); ++j)
+                    moving |= resolveContact(mBalls[j], contacts[j],
+                                             ballTimes[j]);
+
+                if(!moving) break;
+            }
+        }
+
+        // Finds the first surface `mBall` reaches in `mFT`. Only reads the
+        // world, so it can run for several balls at once.
+        Contact findContact(Entity& mBall, Real mFT)
+        {
+            if(mFT <= 0.f || !mBall.isAlive()) return Contact{};
+
+            return sweepBall(
+                    mBall, mBall.getComponent<CPhysics>().velocity * mFT);
+        }
+
+        // Moves `mBall` by `mOffset`, stopping at the first surface in the
+        // way so it cannot be pushed into a brick or out of the field.
+        void pushBall(Entity& mBall, const Vec2& mOffset)
+        {
+            auto contact(sweepBall(mBall, mOffset));
+            mBall.getComponent<CPosition>().position +=
+                    mOffset * contact.hit.time;
+        }
+
+        // Finds the first surface `mBall` reaches moving by `mDisplacement`.
+        Contact sweepBall(Entity& mBall, const Vec2& mDisplacement)
+        {
+            Contact first;
+            auto& cpBall(mBall.getComponent<CPhysics>());
+            SweepHit hit;
+
+            auto sweepWall([&](Real mTime, const Vec2& mNormal)
+                           {
+                               if(mTime > first.hit.time) return;
+
+                               first.target = Contact::Target::Wall;
+                               first.hit = SweepHit{std::max(Real{0.f}, mTime),
+                                                    mNormal};
+                           });
+
+            if(cpBall.onOutOfBounds != nullptr)
+            {
+                if(mDisplacement.x < 0.f)
+                    sweepWall(cpBall.left() / -mDisplacement.x,
+                              Vec2{1.f, 0.f});
+                else if(mDisplacement.x > 0.f)
+                    sweepWall((windowWidth - cpBall.right()) / mDisplacement.x,
+                              Vec2{-1.f, 0.f});
+
+                if(mDisplacement.y < 0.f)
+                    sweepWall(cpBall.top() / -mDisplacement.y,
+                              Vec2{0.f, 1.f});
+                else if(mDisplacement.y > 0.f)
+                    sweepWall((fieldHeight - cpBall.bottom()) /
+                                      mDisplacement.y,
+                              Vec2{0.f, -1.f});
+            }
+
+            auto sweepEntity([&](Contact::Target mTarget,
+                                 const Entity& mEntity, const auto& mBounds)
+                             {
+                                 if(!sweepAABB(cpBall, mDisplacement, mBounds,
+                                               hit) ||
+                                    hit.time >= first.hit.time)
+                                     return;
+
+                                 first.target = mTarget;
+                                 first.other = mEntity;
+                                 first.hit = hit;
+                             });
+
+            for(auto& p : container.getEntitiesByGroup(GPaddle))
+                sweepEntity(Contact::Target::Paddle, p,
+                            p.getComponent<CPhysics>());
+
+            auto swept(getSweptBounds(cpBall, mDisplacement));
+            if(config.gridAlignedBricks)
+            {
+                brickField.forOverlapping(
+                        swept, [&](int mX, int mY)
+                        {
+                            if(!sweepAABB(cpBall, mDisplacement,
+                                          brickField.getBrick(mX, mY), hit) ||
+                               hit.time >= first.hit.time)
+                                return;
+
+                            first.target = Contact::Target::FieldBrick;
+                            first.cellX = mX;
+                            first.cellY = mY;
+                            first.hit = hit;
+                        });
             }
+            else
+            {
+                brickGrid->forOverlapping(
+                        swept, [&](const Entity& mBrick)
+                        {
+                            sweepEntity(Contact::Target::Brick, mBrick,
+                                        mBrick.getComponent<CStaticBody>());
+                        });
+            }
+
+            return first;
+        }
+
+        // Moves `mBall` to `mContact` and bounces it. Another ball may have
+        // broken the brick earlier in the round; the ball still reached it
+        // and bounces. Returns whether the ball has time left to move.
+        bool resolveContact(Entity& mBall, Contact& mContact, Real& mFT)
+        {
+            if(mFT <= 0.f || !mBall.isAlive()) return false;
+
+            auto& cpBall(mBall.getComponent<CPhysics>());
+            mBall.getComponent<CPosition>().position +=
+                    cpBall.velocity * (mFT * mContact.hit.time);
+            mFT *= 1.f - mContact.hit.time;
+
+            switch(mContact.target)
+            {
+                case Contact::Target::None:
+                    mFT = 0.f;
+                    return false;
+
+                case Contact::Target::Wall:
+                    cpBall.onOutOfBounds(cpBall, mContact.hit.normal);
+                    break;
+
+                case Contact::Target::Paddle:
+                    resolvePaddleBall(
+                            mContact.other.getComponent<CPhysics>(), cpBall);
+                    break;
+
+                case Contact::Target::Brick:
+                    if(mContact.other.isAlive())
+                    {
+                        brickGrid->remove(mContact.other);
+                        mContact.other.destroy();
+                    }
+                    reflect(cpBall, mContact.hit.normal);
+                    break;
+
+                case Contact::Target::FieldBrick:
+                    if(brickField.isOccupied(mContact.cellX, mContact.cellY))
+                        brickField.hit(mContact.cellX, mContact.cellY);
+                    reflect(cpBall, mContact.hit.normal);
+                    break;
+            }
+
+            return mFT > 0.f;
         }
 
         void drawPhase()
         {
-            container.draw(this->window);
-            window.display();
+            auto alpha(currentSlice / ftSlice);
+            auto center(getCameraCenter(alpha));
+            auto visible(getVisibleArea(center, center));
+            camera.setCenter(center);
+
+            batch.clear();
+            RenderSystems::run(container, batch, alpha, visible);
+            batchBricks(batch, visible);
+
+            render(batch, brickField, camera);
+        }
+
+        void publishSnapshot()
+        {
+            auto& snapshot(snapshots.getBack());
+
+            snapshot.cameraFrom = getCameraCenter(0.f);
+            snapshot.cameraTo = getCameraCenter(1.f);
+            auto visible(
+                    getVisibleArea(snapshot.cameraFrom, snapshot.cameraTo));
+
+            snapshot.shapes.clear();
+            RenderSystems::run(container, snapshot.shapes, visible);
+            batchBricks(snapshot.shapes, visible);
+
+            if(brickLayer != nullptr) snapshot.bricks = brickField;
+            snapshot.alpha = currentSlice / ftSlice;
+            snapshot.published = chrono::high_resolution_clock::now();
+
+            snapshots.publish();
+        }
+
+        // Keeps the first ball in view, `mAlpha` of the way through the
+        // step, without showing anything past either end of the field.
+        Vector2f getCameraCenter(float mAlpha)
+        {
+            Vector2f center{camera.getCenter()};
+            auto& balls(container.getEntitiesByGroup(GBall));
+            if(balls.empty()) return center;
+
+            auto& cPosition(balls.front().getComponent<CPosition>());
+            auto previous(toFloat(cPosition.previous.y));
+            auto y(previous + (toFloat(cPosition.y()) - previous) * mAlpha);
+
+            auto halfHeight(camera.getSize().y / 2.f);
+            center.y = std::max(
+                    halfHeight, std::min(y, toFloat(fieldHeight) - halfHeight));
+            return center;
+        }
+
+        // What the camera sees anywhere between the two centers.
+        FloatRect getVisibleArea(const Vector2f& mFrom,
+                                 const Vector2f& mTo) const
+        {
+            auto size(camera.getSize());
+            Vector2f topLeft{std::min(mFrom.x, mTo.x) - size.x / 2.f,
+                             std::min(mFrom.y, mTo.y) - size.y / 2.f};
+
+            return FloatRect{topLeft,
+                             size + Vector2f{std::abs(mTo.x - mFrom.x),
+                                             std::abs(mTo.y - mFrom.y)}};
+        }
+
+        // Batches the bricks in view, found through the lattice or the
+        // spatial grid, so drawing costs the same however large the level
+        // is. Lattice bricks drawn by the cached brick layer are skipped.
+        template <typename TBatch>
+        void batchBricks(TBatch& mBatch, const FloatRect& mVisible)
+        {
+            if(config.gridAlignedBricks && brickLayer != nullptr) return;
+
+            Vector2f halfSize{mVisible.width / 2.f, mVisible.height / 2.f};
+            AABB view{Vec2{mVisible.left + halfSize.x,
+                           mVisible.top + halfSize.y},
+                      Vec2{halfSize.x, halfSize.y}};
+
+            if(!config.gridAlignedBricks)
+            {
+                brickGrid->forOverlapping(
+                        view, [&mBatch](const Entity& mBrick)
+                        {
+                            auto& cRectangle(mBrick.getComponent<CRectangle>());
+                            mBatch.addRectangle(
+                                    toVector2f(mBrick.getComponent<CPosition>()
+                                                       .position),
+                                    cRectangle.size, cRectangle.color);
+                        });
+                return;
+            }
+
+            brickField.forOverlapping(
+                    view, [this, &mBatch](int mX, int mY)
+                    {
+                        auto brick(brickField.getBrick(mX, mY));
+                        mBatch.addRectangle(toVector2f(brick.center),
+                                            toVector2f(brick.halfSize) * 2.f,
+                                            Color::Yellow);
+                    });
+        }
+
+        void renderLoop()
+        {
+            window->setActive(true);
+
+            BatchRenderer frame;
+            sf::View view{camera};
+
+            // Frames are paced by display(). Until a newer snapshot
+            // arrives, each frame moves further through the latest one.
+            while(running)
+            {
+                snapshots.acquire();
+                const auto& snapshot(snapshots.getFront());
+
+                chrono::duration<float, milli> age{
+                        chrono::high_resolution_clock::now() -
+                        snapshot.published};
+                auto alpha(
+                        std::min(1.f, snapshot.alpha + age.count() / ftSlice));
+
+                frame.interpolate(snapshot.shapes.from, snapshot.shapes.to,
+                                  alpha);
+                view.setCenter(snapshot.cameraFrom +
+                               (snapshot.cameraTo - snapshot.cameraFrom) *
+                                       alpha);
+                render(frame, snapshot.bricks, view);
+            }
+
+            window->setActive(false);
+        }
+
+        void render(const BatchRenderer& mShapes, const BrickField& mBricks,
+                    const sf::View& mCamera)
+        {
+            window->clear(Color::Black);
+            window->setView(mCamera);
+
+            if(brickLayer != nullptr && config.gridAlignedBricks)
+            {
+                brickLayer->update(mBricks);
+                brickLayer->draw(*window);
+            }
+
+            mShapes.draw(*window);
+            window->display();
+        }
+
+        std::size_t getBrickCount()
+        {
+            return config.gridAlignedBricks
+                           ? brickField.getRemaining()
+                           : container.getEntitiesByGroup(GBrick).size();
         }
     };
+
+    namespace Internal
+    {
+        inline int parseNumber(const std::string& mText, std::size_t* mEnd,
+                               int)
+        {
+            return std::stoi(mText, mEnd);
+        }
+
+        inline float parseNumber(const std::string& mText, std::size_t* mEnd,
+                                 float)
+        {
+            return std::stof(mText, mEnd);
+        }
+
+        inline std::uint64_t parseNumber(const std::string& mText,
+                                         std::size_t* mEnd, std::uint64_t)
+        {
+            // std::stoull accepts a minus sign and wraps the value around.
+            if(mText.find('-') != std::string::npos)
+                throw std::invalid_argument{mText};
+
+            return std::stoull(mText, mEnd);
+        }
+    }
+
+    // Parses all of `mText` into `mValue`. Throws std::invalid_argument
+    // when it is not a number or has trailing characters, and
+    // std::out_of_range when it does not fit.
+    template <typename T>
+    void parseArgument(const std::string& mText, T& mValue)
+    {
+        std::size_t end{0};
+        mValue = Internal::parseNumber(mText, &end, T{});
+        if(end != mText.size()) throw std::invalid_argument{mText};
+    }
 }
 
-int main()
+int main(int argc, char* argv[])
 {
-    Arkanoid::Game{}.run();
+    Arkanoid::GameConfig config;
+    bool valid{true};
+
+    try
+    {
+        for(int i{1}; valid && i < argc; ++i)
+        {
+            std::string arg{argv[i]};
+            bool hasValue{i + 1 < argc};
+
+            if(arg == "--headless")
+                config.headless = true;
+            else if(arg == "--render-thread")
+                config.renderThread = true;
+            else if(arg == "--free-bricks")
+                config.gridAlignedBricks = false;
+            else if(arg == "--steps" && hasValue)
+                Arkanoid::parseArgument(argv[++i], config.maxSteps);
+            else if(arg == "--tick-rate" && hasValue)
+                Arkanoid::parseArgument(argv[++i], config.tickRate);
+            else if(arg == "--rows" && hasValue)
+                Arkanoid::parseArgument(argv[++i], config.brickRows);
+            else
+                valid = false;
+        }
+    }
+    catch(const std::logic_error&)
+    {
+        // std::invalid_argument or std::out_of_range from a bad number.
+        valid = false;
+    }
+
+    // A zero rate would make every step infinitely long.
+    valid = valid && std::isfinite(config.tickRate) && config.tickRate > 0.f;
+    valid = valid && config.brickRows >= 1 &&
+            config.brickRows <= Arkanoid::maxBrickRows;
+
+    // Without a window nothing else would end a headless run.
+    valid = valid && (!config.headless || config.maxSteps != 0);
+
+    if(!valid)
+    {
+        std::cerr << "usage: " << argv[0]
+                  << " [--steps N [--headless]] [--tick-rate HZ]"
+                     " [--rows N] [--render-thread] [--free-bricks]\n";
+        return 1;
+    }
+
+    Arkanoid::Game game{config};
+    auto start(std::chrono::high_resolution_clock::now());
+    game.run();
+
+    // Whether the simulation kept up is reported for every run.
+    std::chrono::duration<float, std::milli> elapsed{
+            std::chrono::high_resolution_clock::now() - start};
+    std::cout << game.stats << " in " << elapsed.count() << " ms, "
+              << game.getBrickCount() << " bricks left\n";
+
     return 0;
 }
\ No newline at end of file